@@ -0,0 +1,198 @@
+#include "BC3.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+namespace {
+    // Weight of the second endpoint for each index of a four colour block
+    const float COLOR_WEIGHTS[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+    uint16_t quantize565(const float* rgb) {
+        unsigned int r = (unsigned int)std::min(std::max(rgb[0] * 31.0f / 255.0f + 0.5f, 0.0f), 31.0f);
+        unsigned int g = (unsigned int)std::min(std::max(rgb[1] * 63.0f / 255.0f + 0.5f, 0.0f), 63.0f);
+        unsigned int b = (unsigned int)std::min(std::max(rgb[2] * 31.0f / 255.0f + 0.5f, 0.0f), 31.0f);
+        return (uint16_t)((r << 11) | (g << 5) | b);
+    }
+
+    void expand565(uint16_t color, float* rgb) {
+        unsigned int r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+        rgb[0] = (float)((r << 3) | (r >> 2));
+        rgb[1] = (float)((g << 2) | (g >> 4));
+        rgb[2] = (float)((b << 3) | (b >> 2));
+    }
+
+    // Picks the nearest palette entry of every texel, returns the squared error
+    float assignColors(const float rgb[16][3], uint16_t c0, uint16_t c1, uint8_t* indices) {
+        float e0[3], e1[3], palette[4][3];
+        expand565(c0, e0);
+        expand565(c1, e1);
+        for (int i = 0; i < 4; i++)
+            for (int c = 0; c < 3; c++)
+                palette[i][c] = e0[c] + (e1[c] - e0[c]) * COLOR_WEIGHTS[i];
+
+        float error = 0.0f;
+        for (int t = 0; t < 16; t++) {
+            float best = FLT_MAX;
+            for (uint8_t i = 0; i < 4; i++) {
+                float d = 0.0f;
+                for (int c = 0; c < 3; c++)
+                    d += (rgb[t][c] - palette[i][c]) * (rgb[t][c] - palette[i][c]);
+                if (d < best) {
+                    best = d;
+                    indices[t] = i;
+                }
+            }
+            error += best;
+        }
+        return error;
+    }
+
+    // Endpoints minimizing the squared error for fixed indices, false when they are all the same
+    bool leastSquares(const float rgb[16][3], const uint8_t* indices, float* e0, float* e1) {
+        float a = 0.0f, b = 0.0f, c = 0.0f;
+        float d0[3] = {}, d1[3] = {};
+        for (int t = 0; t < 16; t++) {
+            float w = COLOR_WEIGHTS[indices[t]];
+            a += (1.0f - w) * (1.0f - w);
+            b += (1.0f - w) * w;
+            c += w * w;
+            for (int ch = 0; ch < 3; ch++) {
+                d0[ch] += (1.0f - w) * rgb[t][ch];
+                d1[ch] += w * rgb[t][ch];
+            }
+        }
+        float det = a * c - b * b;
+        if (std::fabs(det) < 1e-6f)
+            return false;
+        for (int ch = 0; ch < 3; ch++) {
+            e0[ch] = (c * d0[ch] - b * d1[ch]) / det;
+            e1[ch] = (a * d1[ch] - b * d0[ch]) / det;
+        }
+        return true;
+    }
+}
+
+void BC3::encodeAlpha(const glm::uint8* alpha, unsigned char* block, glm::uint8* decoded) {
+    int lo = 255, hi = 0;
+    for (int t = 0; t < 16; t++) {
+        lo = std::min(lo, (int)alpha[t]);
+        hi = std::max(hi, (int)alpha[t]);
+    }
+
+    // With alpha0 > alpha1 the 6 other entries are evenly spaced between them
+    int palette[8] = { hi, lo };
+    for (int i = 2; i < 8; i++)
+        palette[i] = ((8 - i) * hi + (i - 1) * lo + 3) / 7;
+
+    std::memset(block, 0, 8);
+    block[0] = (unsigned char)hi;
+    block[1] = (unsigned char)lo;
+    uint64_t bits = 0;
+    for (int t = 0; t < 16; t++) {
+        int index = 0;
+        if (hi > lo) {
+            for (int i = 1; i < 8; i++) {
+                if (std::abs(palette[i] - alpha[t]) < std::abs(palette[index] - alpha[t]))
+                    index = i;
+            }
+        }
+        bits |= (uint64_t)index << (3 * t);
+        decoded[t] = (glm::uint8)palette[index];
+    }
+    for (int i = 0; i < 6; i++)
+        block[2 + i] = (unsigned char)(bits >> (8 * i));
+}
+
+void BC3::encodeColor(const glm::u8vec4* texels, unsigned char* block) {
+    float rgb[16][3];
+    float mean[3] = {};
+    for (int t = 0; t < 16; t++) {
+        for (int c = 0; c < 3; c++) {
+            rgb[t][c] = (float)texels[t][c];
+            mean[c] += rgb[t][c] / 16.0f;
+        }
+    }
+
+    float cov[6] = {};  // xx, xy, xz, yy, yz, zz
+    float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (int t = 0; t < 16; t++) {
+        float d[3];
+        for (int c = 0; c < 3; c++) {
+            d[c] = rgb[t][c] - mean[c];
+            lo[c] = std::min(lo[c], rgb[t][c]);
+            hi[c] = std::max(hi[c], rgb[t][c]);
+        }
+        cov[0] += d[0] * d[0]; cov[1] += d[0] * d[1]; cov[2] += d[0] * d[2];
+        cov[3] += d[1] * d[1]; cov[4] += d[1] * d[2]; cov[5] += d[2] * d[2];
+    }
+
+    // Power iteration from the diagonal of the bounding box
+    float axis[3] = { hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2] };
+    if (cov[1] < 0.0f)
+        axis[1] = -axis[1];
+    if (cov[2] < 0.0f)
+        axis[2] = -axis[2];
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float next[3] = {
+            cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+            cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+            cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2],
+        };
+        float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+        if (length <= 0.0f)
+            break;
+        for (int c = 0; c < 3; c++)
+            axis[c] = next[c] / length;
+    }
+
+    // Endpoints at the extreme projections of the texels on the axis
+    float tMin = FLT_MAX, tMax = -FLT_MAX;
+    for (int t = 0; t < 16; t++) {
+        float p = (rgb[t][0] - mean[0]) * axis[0] + (rgb[t][1] - mean[1]) * axis[1] + (rgb[t][2] - mean[2]) * axis[2];
+        tMin = std::min(tMin, p);
+        tMax = std::max(tMax, p);
+    }
+    float e0[3], e1[3];
+    for (int c = 0; c < 3; c++) {
+        e0[c] = mean[c] + axis[c] * tMax;
+        e1[c] = mean[c] + axis[c] * tMin;
+    }
+
+    uint16_t c0 = quantize565(e0), c1 = quantize565(e1);
+    uint8_t indices[16];
+    float error = assignColors(rgb, c0, c1, indices);
+
+    uint8_t refined[16];
+    if (error > 0.0f && leastSquares(rgb, indices, e0, e1)) {
+        uint16_t r0 = quantize565(e0), r1 = quantize565(e1);
+        if (assignColors(rgb, r0, r1, refined) < error) {
+            c0 = r0;
+            c1 = r1;
+            std::memcpy(indices, refined, sizeof(indices));
+        }
+    }
+
+    // color0 > color1 selects the four colour mode, swapping the endpoints mirrors the indices
+    if (c0 < c1) {
+        std::swap(c0, c1);
+        for (int t = 0; t < 16; t++)
+            indices[t] ^= 1;
+    }
+    else if (c0 == c1) {
+        std::memset(indices, 0, sizeof(indices));
+    }
+
+    uint32_t bits = 0;
+    for (int t = 0; t < 16; t++)
+        bits |= (uint32_t)indices[t] << (2 * t);
+    block[0] = (unsigned char)(c0 & 0xFF);
+    block[1] = (unsigned char)(c0 >> 8);
+    block[2] = (unsigned char)(c1 & 0xFF);
+    block[3] = (unsigned char)(c1 >> 8);
+    for (int i = 0; i < 4; i++)
+        block[4 + i] = (unsigned char)(bits >> (8 * i));
+}
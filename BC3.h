@@ -0,0 +1,19 @@
+#ifndef __XGP_BC3_H__
+#define __XGP_BC3_H__
+
+#include <glm/glm.hpp>
+
+// BC3 (DXT5) blocks, the 8 bytes of an interpolated alpha block followed by the 8 bytes
+// of a four colour BC1 block. The two halves are encoded separately so that callers can
+// derive the colours from the alpha the decoder will actually see.
+namespace BC3 {
+	// Fits 16 alpha values with the 8 value mode between their extremes and writes the
+	// alpha half of a block. decoded receives the 16 values the block decodes to.
+	void encodeAlpha(const glm::uint8* alpha, unsigned char* block, glm::uint8* decoded);
+
+	// Fits 16 RGB texels (alpha ignored) with the principal axis of their colours, refined
+	// once by least squares, and writes the colour half of a block
+	void encodeColor(const glm::u8vec4* texels, unsigned char* block);
+}
+
+#endif
@@ -0,0 +1,598 @@
+#include "BC6H.h"
+
+#include <CPUFeatures.h>
+#include <Utils.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+    // Interpolation weights of the 3 bit (two regions) and 4 bit (one region) indices, out of 64
+    const int WEIGHTS3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+    const int WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    // The two region partitions BC6H shares with BC7, bit i is set when texel i is in the second region
+    const uint16_t PARTITIONS[32] = {
+        0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+        0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+        0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+        0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+    };
+
+    // Texel of the second region whose index is stored without its most significant bit,
+    // texel 0 is the one of the first region
+    const uint8_t ANCHORS[32] = {
+        15, 15, 15, 15, 15, 15, 15, 15,
+        15, 15, 15, 15, 15, 15, 15, 15,
+        15,  2,  8,  2,  2,  8,  8, 15,
+         2,  8,  2,  2,  8,  8,  2,  2,
+    };
+
+    struct Mode {
+        unsigned int value;         // mode bits as stored
+        unsigned int valueBits;     // 2 or 5
+        unsigned int regions;
+        bool transformed;           // x, y and z stored as deltas from w
+        int endpointBits;
+        int deltaBits[3];           // stored bits of x, y and z per channel
+        // Header after the mode bits, in the notation of the BC6H specification: w and x are
+        // the endpoints of the first region, y and z of the second, d is the partition.
+        // [a:b] lists the bits from b to a.
+        const char* layout;
+    };
+
+    // Modes 1 to 14 of the specification
+    const Mode MODES[14] = {
+        { 0x00, 2, 2, true, 10, { 5, 5, 5 },
+          "gy[4] by[4] bz[4] rw[9:0] gw[9:0] bw[9:0] rx[4:0] gz[4] gy[3:0] gx[4:0] bz[0] gz[3:0] bx[4:0] bz[1] by[3:0] ry[4:0] bz[2] rz[4:0] bz[3] d[4:0]" },
+        { 0x01, 2, 2, true, 7, { 6, 6, 6 },
+          "gy[5] gz[4] gz[5] rw[6:0] bz[0] bz[1] by[4] gw[6:0] by[5] bz[2] gy[4] bw[6:0] bz[3] bz[5] bz[4] rx[5:0] gy[3:0] gx[5:0] gz[3:0] bx[5:0] by[3:0] ry[5:0] rz[5:0] d[4:0]" },
+        { 0x02, 5, 2, true, 11, { 5, 4, 4 },
+          "rw[9:0] gw[9:0] bw[9:0] rx[4:0] rw[10] gy[3:0] gx[3:0] gw[10] bz[0] gz[3:0] bx[3:0] bw[10] bz[1] by[3:0] ry[4:0] bz[2] rz[4:0] bz[3] d[4:0]" },
+        { 0x06, 5, 2, true, 11, { 4, 5, 4 },
+          "rw[9:0] gw[9:0] bw[9:0] rx[3:0] rw[10] gz[4] gy[3:0] gx[4:0] gw[10] gz[3:0] bx[3:0] bw[10] bz[1] by[3:0] ry[3:0] bz[0] bz[2] rz[3:0] gy[4] bz[3] d[4:0]" },
+        { 0x0A, 5, 2, true, 11, { 4, 4, 5 },
+          "rw[9:0] gw[9:0] bw[9:0] rx[3:0] rw[10] by[4] gy[3:0] gx[3:0] gw[10] bz[0] gz[3:0] bx[4:0] bw[10] by[3:0] ry[3:0] bz[1] bz[2] rz[3:0] bz[4] bz[3] d[4:0]" },
+        { 0x0E, 5, 2, true, 9, { 5, 5, 5 },
+          "rw[8:0] by[4] gw[8:0] gy[4] bw[8:0] bz[4] rx[4:0] gz[4] gy[3:0] gx[4:0] bz[0] gz[3:0] bx[4:0] bz[1] by[3:0] ry[4:0] bz[2] rz[4:0] bz[3] d[4:0]" },
+        { 0x12, 5, 2, true, 8, { 6, 5, 5 },
+          "rw[7:0] gz[4] by[4] gw[7:0] bz[2] gy[4] bw[7:0] bz[3] bz[4] rx[5:0] gy[3:0] gx[4:0] bz[0] gz[3:0] bx[4:0] bz[1] by[3:0] ry[5:0] rz[5:0] d[4:0]" },
+        { 0x16, 5, 2, true, 8, { 5, 6, 5 },
+          "rw[7:0] bz[0] by[4] gw[7:0] gy[5] gy[4] bw[7:0] gz[5] bz[4] rx[4:0] gz[4] gy[3:0] gx[5:0] gz[3:0] bx[4:0] bz[1] by[3:0] ry[4:0] bz[2] rz[4:0] bz[3] d[4:0]" },
+        { 0x1A, 5, 2, true, 8, { 5, 5, 6 },
+          "rw[7:0] bz[1] by[4] gw[7:0] by[5] gy[4] bw[7:0] bz[5] bz[4] rx[4:0] gz[4] gy[3:0] gx[4:0] bz[0] gz[3:0] bx[5:0] by[3:0] ry[4:0] bz[2] rz[4:0] bz[3] d[4:0]" },
+        { 0x1E, 5, 2, false, 6, { 6, 6, 6 },
+          "rw[5:0] gz[4] bz[0] bz[1] by[4] gw[5:0] gy[5] by[5] bz[2] gy[4] bw[5:0] gz[5] bz[3] bz[5] bz[4] rx[5:0] gy[3:0] gx[5:0] gz[3:0] bx[5:0] by[3:0] ry[5:0] rz[5:0] d[4:0]" },
+        { 0x03, 5, 1, false, 10, { 10, 10, 10 },
+          "rw[9:0] gw[9:0] bw[9:0] rx[9:0] gx[9:0] bx[9:0]" },
+        { 0x07, 5, 1, true, 11, { 9, 9, 9 },
+          "rw[9:0] gw[9:0] bw[9:0] rx[8:0] rw[10] gx[8:0] gw[10] bx[8:0] bw[10]" },
+        { 0x0B, 5, 1, true, 12, { 8, 8, 8 },
+          "rw[9:0] gw[9:0] bw[9:0] rx[7:0] rw[10:11] gx[7:0] gw[10:11] bx[7:0] bw[10:11]" },
+        { 0x0F, 5, 1, true, 16, { 4, 4, 4 },
+          "rw[9:0] gw[9:0] bw[9:0] rx[3:0] rw[10:15] gx[3:0] gw[10:15] bx[3:0] bw[10:15]" },
+    };
+    const int FIRST_ONE_REGION_MODE = 10;
+
+    // One header bit: bit of channel of endpoint (w, x, y, z), or of the partition when endpoint is 4
+    struct LayoutBit {
+        uint8_t endpoint;
+        uint8_t channel;
+        uint8_t bit;
+    };
+
+    std::vector<LayoutBit> parseLayout(const char* layout) {
+        std::vector<LayoutBit> bits;
+        for (const char* c = layout; *c; ) {
+            if (*c == ' ') {
+                c++;
+                continue;
+            }
+            LayoutBit field = {};
+            if (c[0] == 'd') {
+                field.endpoint = 4;
+                c++;
+            }
+            else {
+                field.channel = (uint8_t)(c[0] == 'r' ? 0 : c[0] == 'g' ? 1 : 2);
+                field.endpoint = (uint8_t)(c[1] == 'w' ? 0 : c[1] - 'x' + 1);
+                c += 2;
+            }
+            // [a:b] or [a]
+            int a = (int)std::strtol(c + 1, (char**)&c, 10);
+            int b = *c == ':' ? (int)std::strtol(c + 1, (char**)&c, 10) : a;
+            c++;
+            for (int bit = b; ; bit += a > b ? 1 : -1) {
+                field.bit = (uint8_t)bit;
+                bits.push_back(field);
+                if (bit == a)
+                    break;
+            }
+        }
+        return bits;
+    }
+
+    const std::vector<LayoutBit>& layout(int mode) {
+        static const std::vector<std::vector<LayoutBit>> layouts = []() {
+            std::vector<std::vector<LayoutBit>> layouts;
+            for (const Mode& m : MODES)
+                layouts.push_back(parseLayout(m.layout));
+            return layouts;
+        }();
+        return layouts[mode];
+    }
+
+    // The block texels as half float bits, which is what the error is measured on, and
+    // in the 16 bit domain the endpoints are unquantized to. A value decodes back to
+    // half h when it lies in [h, h + 1) * 64 / 31, it is stored at the center.
+    struct Texels {
+        float half[3][16];
+        float value[3][16];
+    };
+
+    // Texels of one region, the whole block or one side of a partition
+    struct Region {
+        unsigned int count = 0;
+        uint8_t texels[16];
+    };
+
+    struct Block {
+        int mode = 0;
+        int partition = 0;
+        int endpoints[4][3] = {};   // w, x, y, z at the endpoint precision of the mode
+        uint8_t indices[16] = {};
+        float error = FLT_MAX;
+    };
+
+    // Texels of each region of a partition, a single region holds the whole block
+    void partitionRegions(unsigned int regionCount, int partition, Region regions[2]) {
+        regions[0].count = regions[1].count = 0;
+        for (uint8_t i = 0; i < 16; i++) {
+            Region& region = regions[regionCount == 2 ? (PARTITIONS[partition] >> i) & 1 : 0];
+            region.texels[region.count++] = i;
+        }
+    }
+
+    int unquantize(int value, int bits) {
+        if (bits >= 15)
+            return value;
+        if (value == 0)
+            return 0;
+        if (value == (1 << bits) - 1)
+            return 0xFFFF;
+        return ((value << 16) + 0x8000) >> bits;
+    }
+
+    // Endpoint of bits whose unquantized value is the closest to value
+    int quantize(float value, int bits) {
+        int max = (1 << bits) - 1;
+        int q = std::min(std::max((int)(value * (float)(1 << bits) / 65536.0f), 0), max);
+        int best = q;
+        float bestError = std::fabs((float)unquantize(q, bits) - value);
+        for (int candidate = std::max(q - 1, 0); candidate <= std::min(q + 1, max); candidate++) {
+            float error = std::fabs((float)unquantize(candidate, bits) - value);
+            if (error < bestError) {
+                best = candidate;
+                bestError = error;
+            }
+        }
+        return best;
+    }
+
+    // Half floats the decoder interpolates between two endpoints, per channel
+    void buildPalette(const int* e0, const int* e1, int bits, unsigned int indexBits, float palette[3][16]) {
+        const int* weights = indexBits == 3 ? WEIGHTS3 : WEIGHTS4;
+        for (int c = 0; c < 3; c++) {
+            int u0 = unquantize(e0[c], bits);
+            int u1 = unquantize(e1[c], bits);
+            for (unsigned int i = 0; i < (1u << indexBits); i++)
+                palette[c][i] = (float)(((((64 - weights[i]) * u0 + weights[i] * u1 + 32) >> 6) * 31) >> 6);
+        }
+    }
+
+    // Closest palette entry of the texels from begin to count, and its squared error
+    void assignScalar(const float* r, const float* g, const float* b, unsigned int begin, unsigned int count,
+                      const float palette[3][16], unsigned int entries, uint8_t* indices, float* errors) {
+        for (unsigned int i = begin; i < count; i++) {
+            float best = FLT_MAX;
+            for (unsigned int k = 0; k < entries; k++) {
+                float dr = palette[0][k] - r[i], dg = palette[1][k] - g[i], db = palette[2][k] - b[i];
+                float d = dr * dr + dg * dg + db * db;
+                if (d < best) {
+                    best = d;
+                    indices[i] = (uint8_t)k;
+                }
+            }
+            errors[i] = best;
+        }
+    }
+
+#ifdef CPU_X86
+    // 4 texels at a time, returns how many were done
+    CPU_TARGET("sse2")
+    unsigned int assignSSE2(const float* r, const float* g, const float* b, unsigned int count,
+                            const float palette[3][16], unsigned int entries, uint8_t* indices, float* errors) {
+        unsigned int i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128 tr = _mm_loadu_ps(r + i), tg = _mm_loadu_ps(g + i), tb = _mm_loadu_ps(b + i);
+            __m128 best = _mm_set1_ps(FLT_MAX);
+            __m128 bestIndex = _mm_setzero_ps();
+            for (unsigned int k = 0; k < entries; k++) {
+                __m128 dr = _mm_sub_ps(_mm_set1_ps(palette[0][k]), tr);
+                __m128 dg = _mm_sub_ps(_mm_set1_ps(palette[1][k]), tg);
+                __m128 db = _mm_sub_ps(_mm_set1_ps(palette[2][k]), tb);
+                __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+                // No blendv before SSE4.1: select with and/andnot masks
+                __m128 closer = _mm_cmplt_ps(d, best);
+                best = _mm_min_ps(d, best);
+                bestIndex = _mm_or_ps(_mm_and_ps(closer, _mm_set1_ps((float)k)), _mm_andnot_ps(closer, bestIndex));
+            }
+            _mm_storeu_ps(errors + i, best);
+            alignas(16) int32_t index[4];
+            _mm_store_si128((__m128i*)index, _mm_cvttps_epi32(bestIndex));
+            for (int j = 0; j < 4; j++)
+                indices[i + j] = (uint8_t)index[j];
+        }
+        return i;
+    }
+#endif
+
+    // Assigns the closest palette entry to every texel of region, returns the squared error
+    float assignIndices(const Texels& t, const Region& region, const float palette[3][16], unsigned int entries, uint8_t* indices) {
+        float r[16], g[16], b[16];
+        for (unsigned int i = 0; i < region.count; i++) {
+            r[i] = t.half[0][region.texels[i]];
+            g[i] = t.half[1][region.texels[i]];
+            b[i] = t.half[2][region.texels[i]];
+        }
+
+        uint8_t regionIndices[16];
+        float errors[16];
+        unsigned int i = 0;
+#ifdef CPU_X86
+        i = assignSSE2(r, g, b, region.count, palette, entries, regionIndices, errors);
+#endif
+        assignScalar(r, g, b, i, region.count, palette, entries, regionIndices, errors);
+
+        float error = 0.0f;
+        for (unsigned int i = 0; i < region.count; i++) {
+            indices[region.texels[i]] = regionIndices[i];
+            error += errors[i];
+        }
+        return error;
+    }
+
+    // Endpoints at both ends of the principal axis of the region, before quantization.
+    // Returns the squared distance of the texels to that line.
+    float fitLine(const Texels& t, const Region& region, float e0[3], float e1[3]) {
+        float mean[3] = {};
+        for (unsigned int i = 0; i < region.count; i++)
+            for (int c = 0; c < 3; c++)
+                mean[c] += t.value[c][region.texels[i]];
+        for (int c = 0; c < 3; c++)
+            mean[c] /= (float)region.count;
+
+        float cov[6] = {};  // xx, xy, xz, yy, yz, zz
+        float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+        for (unsigned int i = 0; i < region.count; i++) {
+            float d[3];
+            for (int c = 0; c < 3; c++) {
+                float v = t.value[c][region.texels[i]];
+                d[c] = v - mean[c];
+                lo[c] = std::min(lo[c], v);
+                hi[c] = std::max(hi[c], v);
+            }
+            cov[0] += d[0] * d[0]; cov[1] += d[0] * d[1]; cov[2] += d[0] * d[2];
+            cov[3] += d[1] * d[1]; cov[4] += d[1] * d[2]; cov[5] += d[2] * d[2];
+        }
+
+        // Power iteration from the diagonal of the bounding box
+        float axis[3] = { hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2] };
+        if (cov[1] < 0.0f)
+            axis[1] = -axis[1];
+        if (cov[2] < 0.0f)
+            axis[2] = -axis[2];
+        float lambda = 0.0f;
+        for (int iteration = 0; iteration < 8; iteration++) {
+            float next[3] = {
+                cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+                cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+                cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2],
+            };
+            float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+            if (length <= 0.0f)
+                break;
+            float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+            lambda = length / axisLength;
+            for (int c = 0; c < 3; c++)
+                axis[c] = next[c] / length;
+        }
+
+        float tMin = 0.0f, tMax = 0.0f;
+        float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+        if (axisLength > 0.0f) {
+            for (int c = 0; c < 3; c++)
+                axis[c] /= axisLength;
+            tMin = FLT_MAX;
+            tMax = -FLT_MAX;
+            for (unsigned int i = 0; i < region.count; i++) {
+                float s = 0.0f;
+                for (int c = 0; c < 3; c++)
+                    s += (t.value[c][region.texels[i]] - mean[c]) * axis[c];
+                tMin = std::min(tMin, s);
+                tMax = std::max(tMax, s);
+            }
+        }
+        for (int c = 0; c < 3; c++) {
+            e0[c] = std::min(std::max(mean[c] + tMin * axis[c], 0.0f), 65535.0f);
+            e1[c] = std::min(std::max(mean[c] + tMax * axis[c], 0.0f), 65535.0f);
+        }
+        return std::max(cov[0] + cov[3] + cov[5] - lambda, 0.0f);
+    }
+
+    // Endpoints minimizing the squared error of the indices of the region, before quantization
+    bool leastSquares(const Texels& t, const Region& region, const uint8_t* indices, unsigned int indexBits, float e0[3], float e1[3]) {
+        const int* weights = indexBits == 3 ? WEIGHTS3 : WEIGHTS4;
+        float a = 0.0f, b = 0.0f, c = 0.0f;
+        float d0[3] = {}, d1[3] = {};
+        for (unsigned int i = 0; i < region.count; i++) {
+            unsigned int texel = region.texels[i];
+            float w = (float)weights[indices[texel]] / 64.0f;
+            a += (1.0f - w) * (1.0f - w);
+            b += (1.0f - w) * w;
+            c += w * w;
+            for (int ch = 0; ch < 3; ch++) {
+                d0[ch] += (1.0f - w) * t.value[ch][texel];
+                d1[ch] += w * t.value[ch][texel];
+            }
+        }
+        float det = a * c - b * b;
+        if (std::fabs(det) < 1e-6f)
+            return false;
+        for (int ch = 0; ch < 3; ch++) {
+            e0[ch] = std::min(std::max((c * d0[ch] - b * d1[ch]) / det, 0.0f), 65535.0f);
+            e1[ch] = std::min(std::max((a * d1[ch] - b * d0[ch]) / det, 0.0f), 65535.0f);
+        }
+        return true;
+    }
+
+    // Whether the other endpoints of a transformed mode are within a delta of endpoint base
+    bool deltasFit(const Mode& m, const int endpoints[4][3], unsigned int base) {
+        for (unsigned int e = 0; e < 2 * m.regions; e++) {
+            for (int c = 0; c < 3; c++) {
+                int delta = endpoints[e][c] - endpoints[base][c];
+                if (delta < -(1 << (m.deltaBits[c] - 1)) || delta >= (1 << (m.deltaBits[c] - 1)))
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    // Assigns the indices of quantized endpoints, then swaps the endpoints of the regions
+    // whose anchor index would need its most significant bit. Fails as soon as the error
+    // reaches bound, or when the deltas of a transformed mode don't fit.
+    bool evaluate(const Texels& t, const Region* regions, const int endpoints[4][3], int mode, int partition, float bound, Block& block) {
+        const Mode& m = MODES[mode];
+        unsigned int indexBits = m.regions == 2 ? 3 : 4;
+        unsigned int entries = 1u << indexBits;
+
+        Block candidate;
+        candidate.mode = mode;
+        candidate.partition = partition;
+        std::memcpy(candidate.endpoints, endpoints, sizeof(candidate.endpoints));
+        candidate.error = 0.0f;
+        for (unsigned int r = 0; r < m.regions; r++) {
+            float palette[3][16];
+            buildPalette(endpoints[2 * r], endpoints[2 * r + 1], m.endpointBits, indexBits, palette);
+            candidate.error += assignIndices(t, regions[r], palette, entries, candidate.indices);
+            if (candidate.error >= bound)
+                return false;
+
+            // Swapping the endpoints mirrors the weights, the palette is the same backwards
+            unsigned int anchor = r == 0 ? 0 : ANCHORS[partition];
+            if (candidate.indices[anchor] >= entries / 2) {
+                std::swap(candidate.endpoints[2 * r], candidate.endpoints[2 * r + 1]);
+                for (unsigned int i = 0; i < regions[r].count; i++)
+                    candidate.indices[regions[r].texels[i]] = (uint8_t)(entries - 1 - candidate.indices[regions[r].texels[i]]);
+            }
+        }
+        if (m.transformed && !deltasFit(m, candidate.endpoints, 0))
+            return false;
+
+        block = candidate;
+        return true;
+    }
+
+    // Fits mode to the regions from the line endpoints, refining them by least squares.
+    // block is replaced when the result is valid and better.
+    void encodeMode(const Texels& t, const Region* regions, const float lines[2][2][3], int mode, int partition, int refinements, Block& block) {
+        const Mode& m = MODES[mode];
+        unsigned int indexBits = m.regions == 2 ? 3 : 4;
+
+        float ends[2][2][3];
+        std::memcpy(ends, lines, sizeof(ends));
+        for (int iteration = 0; iteration <= refinements; iteration++) {
+            int endpoints[4][3] = {};
+            for (unsigned int r = 0; r < m.regions; r++)
+                for (int e = 0; e < 2; e++)
+                    for (int c = 0; c < 3; c++)
+                        endpoints[2 * r + e][c] = quantize(ends[r][e][c], m.endpointBits);
+            // Either endpoint of the first region may end up as the base once the anchor is fixed
+            if (m.transformed && !deltasFit(m, endpoints, 0) && !deltasFit(m, endpoints, 1))
+                return;
+
+            // Candidates much worse than the best block are not worth refining
+            Block candidate;
+            float bound = iteration < refinements ? 2.0f * block.error : block.error;
+            if (!evaluate(t, regions, endpoints, mode, partition, bound, candidate))
+                return;
+            if (candidate.error < block.error)
+                block = candidate;
+            if (iteration == refinements || candidate.error == 0.0f)
+                return;
+
+            // The swapped anchors don't matter to the fit, it only uses the weights
+            for (unsigned int r = 0; r < m.regions; r++) {
+                if (!leastSquares(t, regions[r], candidate.indices, indexBits, ends[r][0], ends[r][1]))
+                    return;
+            }
+        }
+    }
+
+    // Tries the neighbours of every quantized endpoint of block until none is better
+    void refineEndpoints(const Texels& t, Block& block) {
+        const Mode& m = MODES[block.mode];
+        Region regions[2];
+        partitionRegions(m.regions, block.partition, regions);
+        int max = (1 << m.endpointBits) - 1;
+        for (int pass = 0; pass < 8; pass++) {
+            bool improved = false;
+            for (unsigned int e = 0; e < 2 * m.regions; e++) {
+                for (int c = 0; c < 3; c++) {
+                    for (int step = -1; step <= 1; step += 2) {
+                        int endpoints[4][3];
+                        std::memcpy(endpoints, block.endpoints, sizeof(endpoints));
+                        endpoints[e][c] += step;
+                        if (endpoints[e][c] < 0 || endpoints[e][c] > max)
+                            continue;
+                        improved |= evaluate(t, regions, endpoints, block.mode, block.partition, block.error, block);
+                    }
+                }
+            }
+            if (!improved)
+                break;
+        }
+    }
+
+    void putBits(unsigned char* block, unsigned int& position, unsigned int value, unsigned int count) {
+        for (unsigned int i = 0; i < count; i++, position++) {
+            if ((value >> i) & 1)
+                block[position >> 3] |= (unsigned char)(1 << (position & 7));
+        }
+    }
+
+    void pack(const Block& block, unsigned char* out) {
+        const Mode& m = MODES[block.mode];
+        std::memset(out, 0, 16);
+        unsigned int position = 0;
+        putBits(out, position, m.value, m.valueBits);
+
+        // Transformed modes store x, y and z as deltas, truncated to their bits
+        int stored[4][3];
+        std::memcpy(stored, block.endpoints, sizeof(stored));
+        if (m.transformed) {
+            for (int e = 1; e < 4; e++)
+                for (int c = 0; c < 3; c++)
+                    stored[e][c] = (block.endpoints[e][c] - block.endpoints[0][c]) & ((1 << m.deltaBits[c]) - 1);
+        }
+        for (const LayoutBit& bit : layout(block.mode)) {
+            int value = bit.endpoint == 4 ? block.partition : stored[bit.endpoint][bit.channel];
+            putBits(out, position, (unsigned int)(value >> bit.bit) & 1, 1);
+        }
+
+        // Anchor indices drop their most significant bit, it is always 0
+        unsigned int indexBits = m.regions == 2 ? 3 : 4;
+        for (unsigned int i = 0; i < 16; i++) {
+            bool anchor = i == 0 || (m.regions == 2 && i == ANCHORS[block.partition]);
+            putBits(out, position, block.indices[i], anchor ? indexBits - 1 : indexBits);
+        }
+    }
+
+    void loadTexels(const glm::uint16* rgb, Texels& t) {
+        for (int i = 0; i < 16; i++) {
+            for (int c = 0; c < 3; c++) {
+                unsigned int h = rgb[3 * i + c];
+                if (h & 0x8000)
+                    h = 0;  // negative
+                else if ((h & 0x7C00) == 0x7C00)
+                    h = (h & 0x3FF) ? 0 : 0x7BFF;  // NaN, infinity
+                t.half[c][i] = (float)h;
+                t.value[c][i] = ((float)h + 0.5f) * (64.0f / 31.0f);
+            }
+        }
+    }
+}
+
+void BC6H::encodeBlock(const glm::uint16* rgb, BC6HQuality quality, unsigned char* out) {
+    Texels t;
+    loadTexels(rgb, t);
+
+    int refinements = quality == BC6HQuality::Fast ? 0 : quality == BC6HQuality::Normal ? 1 : 2;
+
+    // Single region modes, from the 10 bit endpoints to the 16 bit base and 4 bit deltas
+    Region single[2];
+    partitionRegions(1, 0, single);
+    float lines[2][2][3] = {};
+    fitLine(t, single[0], lines[0][0], lines[0][1]);
+
+    Block best;
+    int lastMode = quality == BC6HQuality::Fast ? FIRST_ONE_REGION_MODE : 13;
+    for (int mode = FIRST_ONE_REGION_MODE; mode <= lastMode; mode++)
+        encodeMode(t, single, lines, mode, 0, refinements, best);
+
+    if (quality != BC6HQuality::Fast && best.error > 0.0f) {
+        // Partitions ranked by how well two lines fit their regions
+        struct Candidate {
+            float residual;
+            int partition;
+            Region regions[2];
+            float lines[2][2][3];
+        };
+        std::vector<Candidate> candidates(32);
+        for (int p = 0; p < 32; p++) {
+            Candidate& candidate = candidates[p];
+            candidate.partition = p;
+            partitionRegions(2, p, candidate.regions);
+            candidate.residual = fitLine(t, candidate.regions[0], candidate.lines[0][0], candidate.lines[0][1])
+                               + fitLine(t, candidate.regions[1], candidate.lines[1][0], candidate.lines[1][1]);
+        }
+        size_t tried = quality == BC6HQuality::Normal ? 4 : candidates.size();
+        std::partial_sort(candidates.begin(), candidates.begin() + tried, candidates.end(),
+            [](const Candidate& a, const Candidate& b) { return a.residual < b.residual; });
+
+        for (size_t i = 0; i < tried; i++) {
+            for (int mode = 0; mode < FIRST_ONE_REGION_MODE; mode++)
+                encodeMode(t, candidates[i].regions, candidates[i].lines, mode, candidates[i].partition, refinements, best);
+        }
+    }
+
+    if (quality == BC6HQuality::Slow && best.error > 0.0f)
+        refineEndpoints(t, best);
+
+    pack(best, out);
+}
+
+gli::texture_cube BC6H::encode(const gli::texture_cube& cubemap, BC6HQuality quality) {
+    GLI_ASSERT(cubemap.format() == gli::FORMAT_RGB16_SFLOAT_PACK16);
+    gli::texture_cube encoded(gli::FORMAT_RGB_BP_UFLOAT_BLOCK16, cubemap.extent(), cubemap.levels());
+
+    for (size_t face = 0; face < 6; face++) {
+        for (size_t level = 0; level < cubemap.levels(); level++) {
+            encodeFace(cubemap.data<glm::uint16>(0, face, level), (unsigned int)cubemap.extent(level).x, quality,
+                       encoded.data<unsigned char>(0, face, level));
+        }
+    }
+    return encoded;
+}
+
+void BC6H::encodeFace(const glm::uint16* rgb, unsigned int size, BC6HQuality quality, unsigned char* blocks) {
+    // One job per row of blocks
+    unsigned int blocksX = (size + 3) / 4;
+    Utils::parallelFor(blocksX, [&](unsigned int by) {
+        glm::uint16 texels[3 * 16];
+        for (unsigned int bx = 0; bx < blocksX; bx++) {
+            // Levels smaller than a block repeat their edge texels
+            for (unsigned int i = 0; i < 16; i++) {
+                unsigned int x = std::min(4 * bx + i % 4, size - 1);
+                unsigned int y = std::min(4 * by + i / 4, size - 1);
+                std::memcpy(texels + 3 * i, rgb + 3 * ((size_t)y * size + x), 3 * sizeof(glm::uint16));
+            }
+            encodeBlock(texels, quality, blocks + 16 * ((size_t)by * blocksX + bx));
+        }
+    });
+}
@@ -0,0 +1,31 @@
+#ifndef __XGP_BC6H_H__
+#define __XGP_BC6H_H__
+
+#include <glm/glm.hpp>
+#include <gli/gli.hpp>
+
+#include <Bake.h>
+
+// BC6H (unsigned half float) block compression of the baked cubemaps, 6 times smaller
+// than RGB16F. Each 4x4 block is fitted in the integer domain of the half floats, which
+// keeps the error relative to the texel values like the format itself does:
+//  - Fast only tries the single region mode with 10 bit endpoints
+//  - Normal tries every single region mode, and the two region modes on the partitions
+//    whose two lines fit the block best, refining the endpoints by least squares once
+//  - Slow tries every partition, refines twice and finishes with a search of the
+//    neighbouring quantized endpoints
+// The palette of every candidate is matched against 4 texels at a time with SSE2.
+namespace BC6H {
+	// Encodes every face and level of an RGB16F cubemap into a FORMAT_RGB_BP_UFLOAT_BLOCK16
+	// one, with the blocks spread over all hardware threads. Negative texels are clamped to 0.
+	gli::texture_cube encode(const gli::texture_cube& cubemap, BC6HQuality quality);
+
+	// Encodes one size x size face of RGB half floats into its rows of blocks, with the
+	// rows spread over all hardware threads
+	void encodeFace(const glm::uint16* rgb, unsigned int size, BC6HQuality quality, unsigned char* blocks);
+
+	// Encodes 16 RGB half float texels, row after row, into one 16 byte block
+	void encodeBlock(const glm::uint16* rgb, BC6HQuality quality, unsigned char* block);
+}
+
+#endif
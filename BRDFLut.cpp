@@ -0,0 +1,157 @@
+#include "BRDFLut.h"
+
+#include <CPUFeatures.h>
+#include <Half.h>
+#include <Utils.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+static const float PI = 3.14159265359f;
+
+namespace {
+    float radicalInverse(unsigned int bits) {
+        bits = (bits << 16u) | (bits >> 16u);
+        bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+        bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+        bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+        bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+        return (float)bits * 2.3283064365386963e-10f; // / 0x100000000
+    }
+
+    // The Hammersley points only depend on the sample index: their radical inverse and
+    // the cosine of their azimuth are shared by every texel. With V in the XZ plane the
+    // sine of the azimuth is never needed.
+    struct SampleTable {
+        std::vector<float> xi;
+        std::vector<float> cosPhi;
+
+        SampleTable(unsigned int sampleCount)
+            : xi(sampleCount), cosPhi(sampleCount) {
+            for (unsigned int i = 0; i < sampleCount; i++) {
+                xi[i] = radicalInverse(i);
+                cosPhi[i] = std::cos(2.0f * PI * (float)i / (float)sampleCount);
+            }
+        }
+    };
+
+    // Smith GGX geometry term with the IBL remapping k = a / 2
+    float geometrySchlickGGX(float NdotX, float k) {
+        return NdotX / (NdotX * (1.0f - k) + k);
+    }
+
+    // Accumulates samples [begin, end) of the integral into scale and bias
+    void integrateScalar(const SampleTable& table, unsigned int begin, unsigned int end,
+                         float NdotV, float roughness, float& scale, float& bias) {
+        float a = roughness * roughness;
+        float a2 = a * a;
+        float k = a / 2.0f;
+        float Vx = std::sqrt(1.0f - NdotV * NdotV);
+        float Vz = NdotV;
+        float GV = geometrySchlickGGX(NdotV, k);
+
+        for (unsigned int i = begin; i < end; i++) {
+            float y = table.xi[i];
+            float cosTheta = std::sqrt((1.0f - y) / (1.0f + (a2 - 1.0f) * y));
+            float sinTheta = std::sqrt(std::max(1.0f - cosTheta * cosTheta, 0.0f));
+            float Hx = table.cosPhi[i] * sinTheta;
+            float Hz = cosTheta;
+
+            float VdotH = Vx * Hx + Vz * Hz;
+            float NdotL = 2.0f * VdotH * Hz - Vz;
+            if (NdotL <= 0.0f)
+                continue;
+
+            VdotH = std::max(VdotH, 0.0f);
+            float G = GV * geometrySchlickGGX(NdotL, k);
+            float GVis = (G * VdotH) / (Hz * NdotV);
+            float Fc = std::pow(1.0f - VdotH, 5.0f);
+
+            scale += (1.0f - Fc) * GVis;
+            bias += Fc * GVis;
+        }
+    }
+
+#ifdef CPU_X86
+    // Same loop over 4 samples per iteration, returns the first sample left to the scalar loop
+    CPU_TARGET("sse2")
+    unsigned int integrateSSE2(const SampleTable& table, unsigned int count,
+                               float NdotV, float roughness, float& scale, float& bias) {
+        float a = roughness * roughness;
+        float k = a / 2.0f;
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 a2m1 = _mm_set1_ps(a * a - 1.0f);
+        const __m128 oneMinusK = _mm_set1_ps(1.0f - k);
+        const __m128 kk = _mm_set1_ps(k);
+        const __m128 Vx = _mm_set1_ps(std::sqrt(1.0f - NdotV * NdotV));
+        const __m128 Vz = _mm_set1_ps(NdotV);
+        const __m128 GVoverNdotV = _mm_set1_ps(geometrySchlickGGX(NdotV, k) / NdotV);
+
+        __m128 scale4 = zero;
+        __m128 bias4 = zero;
+        unsigned int i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128 y = _mm_loadu_ps(&table.xi[i]);
+            __m128 cosTheta = _mm_sqrt_ps(_mm_div_ps(_mm_sub_ps(one, y), _mm_add_ps(one, _mm_mul_ps(a2m1, y))));
+            __m128 sinTheta = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(one, _mm_mul_ps(cosTheta, cosTheta)), zero));
+            __m128 Hx = _mm_mul_ps(_mm_loadu_ps(&table.cosPhi[i]), sinTheta);
+
+            __m128 VdotH = _mm_add_ps(_mm_mul_ps(Vx, Hx), _mm_mul_ps(Vz, cosTheta));
+            __m128 NdotL = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(VdotH, VdotH), cosTheta), Vz);
+            __m128 contributes = _mm_cmpgt_ps(NdotL, zero);
+
+            VdotH = _mm_max_ps(VdotH, zero);
+            __m128 GL = _mm_div_ps(NdotL, _mm_add_ps(_mm_mul_ps(NdotL, oneMinusK), kk));
+            __m128 GVis = _mm_div_ps(_mm_mul_ps(_mm_mul_ps(GVoverNdotV, GL), VdotH), cosTheta);
+            GVis = _mm_and_ps(GVis, contributes);
+
+            __m128 f = _mm_sub_ps(one, VdotH);
+            __m128 f2 = _mm_mul_ps(f, f);
+            __m128 Fc = _mm_mul_ps(_mm_mul_ps(f2, f2), f);
+
+            scale4 = _mm_add_ps(scale4, _mm_mul_ps(_mm_sub_ps(one, Fc), GVis));
+            bias4 = _mm_add_ps(bias4, _mm_mul_ps(Fc, GVis));
+        }
+
+        float s[4], b[4];
+        _mm_storeu_ps(s, scale4);
+        _mm_storeu_ps(b, bias4);
+        scale += (s[0] + s[1]) + (s[2] + s[3]);
+        bias += (b[0] + b[1]) + (b[2] + b[3]);
+        return i;
+    }
+#endif
+
+    glm::vec2 integrate(const SampleTable& table, float NdotV, float roughness) {
+        unsigned int count = (unsigned int)table.xi.size();
+        float scale = 0.0f;
+        float bias = 0.0f;
+        unsigned int i = 0;
+#ifdef CPU_X86
+        i = integrateSSE2(table, count, NdotV, roughness, scale, bias);
+#endif
+        integrateScalar(table, i, count, NdotV, roughness, scale, bias);
+        return glm::vec2(scale, bias) / (float)count;
+    }
+}
+
+gli::texture2d BRDFLut::generate(unsigned int size, unsigned int sampleCount) {
+    SampleTable table(sampleCount);
+    gli::texture2d lut(gli::FORMAT_RG16_SFLOAT_PACK16, gli::extent2d(size, size), 1);
+
+    // Rows are bottom-up like GL textures: row y holds roughness (y + 0.5) / size
+    Utils::parallelFor(size, [&](unsigned int y) {
+        float roughness = (y + 0.5f) / size;
+        std::vector<float> row(2 * size);
+        for (unsigned int x = 0; x < size; x++) {
+            float NdotV = (x + 0.5f) / size;
+            glm::vec2 texel = integrate(table, NdotV, roughness);
+            row[2 * x] = texel.x;
+            row[2 * x + 1] = texel.y;
+        }
+        Half::fromFloat(row.data(), lut.data<glm::uint16>(0, 0, 0) + 2 * (size_t)y * size, row.size());
+    });
+    return lut;
+}
@@ -0,0 +1,17 @@
+#ifndef __XGP_BRDFLUT_H__
+#define __XGP_BRDFLUT_H__
+
+#include <gli/gli.hpp>
+
+#include <string>
+
+// Split-sum BRDF integration table: the scale (R) and bias (G) applied to F0 by the
+// GGX specular lobe with Schlick Fresnel, over NdotV along x and roughness along y.
+// It does not depend on the environment, so one table serves every baked probe.
+namespace BRDFLut {
+	// Integrates sampleCount GGX importance samples per texel of a size x size RG16F
+	// table, with rows spread over all hardware threads and 4 samples at a time on SSE2
+	gli::texture2d generate(unsigned int size, unsigned int sampleCount);
+}
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef __XGP_BAKE_H__
+#define __XGP_BAKE_H__
+
+#include <gli/gli.hpp>
+
+#include <SphericalHarmonics.h>
+
+#include <functional>
+
+// Options and products shared by the OpenGL and CPU bakers
+
+enum class IrradianceMode {
+	Convolution,    // brute force hemisphere integral of irradiance.fs
+	SH,             // irradiance.dds rebuilt from an L2 SH projection, plus the SH sidecar
+	SHOnly          // SH sidecar only, no irradiance.dds
+};
+
+// Format the cubemaps are saved in. The bakers always produce RGB16F, the other
+// formats are encoded from it when the maps are saved.
+enum class OutputFormat {
+	RGB16F,
+	BC6H,           // BC6H_UF16 blocks, see BC6H.h
+	RGB9E5,         // shared exponent, see RGB9E5.h
+	RGBM,           // 8 bit RGBA with a range per level, see RGBM.h
+	RGBD
+};
+
+enum class BC6HQuality {
+	Fast,
+	Normal,
+	Slow
+};
+
+struct BakeOptions {
+	unsigned int envRes = 0;
+	unsigned int irradianceRes = 0;
+	unsigned int prefilterRes = 0;
+	unsigned int prefilterLevels = 0;
+	// GGX samples per prefilter level, 0 derives them from the roughness of each level
+	unsigned int prefilterSamples = 0;
+	// Environment samples drawn from the luminance of the environment (see LightSampler) and
+	// combined with the BRDF samples by multiple importance sampling, 0 disables it. The
+	// irradiance convolution then takes as many cosine weighted samples instead of its fixed
+	// grid, and both passes read the environment at the resolution of the light sampler.
+	unsigned int lightSamples = 0;
+
+	bool useCPU = false;
+	// Average the equirectangular image over the footprint of every environment texel
+	// with a summed-area table (on the CPU for both backends) instead of taking one
+	// bilinear tap, for panoramas much larger than the environment map
+	bool areaFilter = false;
+	// Read GL results back as half floats straight into the gli storage instead of
+	// converting float readbacks texel by texel. Lossless since the targets are RGB16F.
+	bool halfReadback = true;
+	// Render the six faces of a cubemap level with one instanced draw routed by gl_Layer,
+	// instead of one framebuffer attachment, clear and draw per face
+	bool layeredRendering = true;
+	// Run the irradiance and prefilter passes as GL 4.3 compute shaders writing the
+	// cubemaps with imageStore, falls back to rendering when GL 4.3 is missing
+	bool computeShaders = false;
+	IrradianceMode irradiance = IrradianceMode::Convolution;
+	OutputFormat outputFormat = OutputFormat::RGB16F;
+	BC6HQuality bc6hQuality = BC6HQuality::Normal;
+	// Compress RGBM and RGBD outputs further to BC3 blocks
+	bool bc3 = false;
+	// Save all the maps of an image, the SH coefficients and the BRDF LUT in a single
+	// probe.bundle instead of separate files, see ProbeBundle.h
+	bool bundle = false;
+	// Write every image to one layer of cubemap array files in output/array instead of
+	// its own folder, baking the layers in batches that share every pass
+	bool cubemapArray = false;
+	// Skip images whose outputs are up to date and reuse their environment map when
+	// only later passes changed, see BakeCache
+	bool useCache = true;
+};
+
+struct BakeResult {
+	gli::texture_cube envMap;
+	gli::texture_cube irradianceMap;    // empty with IrradianceMode::SHOnly
+	gli::texture_cube prefilterMap;
+	SphericalHarmonics irradianceSH;    // only set outside of IrradianceMode::Convolution
+};
+
+enum class BakeMap {
+	Environment,
+	Irradiance,
+	Prefilter
+};
+
+// Receives every map of a bake as soon as it is read back, with the layer of the image
+// in the batch, so that it is saved while the next passes run. A map handed to the sink
+// is left empty in BakeResult, without a sink the maps are all kept in it.
+typedef std::function<void(size_t layer, BakeMap map, gli::texture_cube&& cubemap)> BakeSink;
+
+// Moves cubemap into sink when there is one
+inline void emitMap(const BakeSink& sink, size_t layer, BakeMap map, gli::texture_cube& cubemap) {
+	if (!sink)
+		return;
+	sink(layer, map, std::move(cubemap));
+	cubemap = gli::texture_cube();
+}
+
+#endif
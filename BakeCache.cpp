@@ -0,0 +1,154 @@
+#include "BakeCache.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+// Bump whenever the baking code changes its results without any option or shader changing
+#define BAKE_CACHE_VERSION 3
+
+#define MANIFEST_NAME "bake_manifest.txt"
+#define LUT_MANIFEST_NAME "brdf_lut_manifest.txt"
+
+namespace {
+    const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+    const uint64_t FNV_PRIME = 1099511628211ull;
+
+    // 64 bit FNV-1a
+    uint64_t hash(const void* data, size_t size, uint64_t seed = FNV_OFFSET_BASIS) {
+        const unsigned char* bytes = (const unsigned char*)data;
+        uint64_t h = seed;
+        for (size_t i = 0; i < size; i++) {
+            h ^= bytes[i];
+            h *= FNV_PRIME;
+        }
+        return h;
+    }
+
+    uint64_t hashValue(unsigned int value, uint64_t seed) {
+        return hash(&value, sizeof(value), seed);
+    }
+
+    // A missing shader hashes like an empty one, the baker reports it when it compiles
+    uint64_t hashFile(const std::string& filepath, uint64_t seed) {
+        std::ifstream input(filepath, std::ios_base::in | std::ios_base::binary);
+        std::vector<char> file((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+        return hash(file.data(), file.size(), hashValue((unsigned int)file.size(), seed));
+    }
+
+    std::string manifestPath(const std::string& folder, const char* name = MANIFEST_NAME) {
+        return folder + "/" + name;
+    }
+}
+
+BakeCache::BakeCache(const BakeOptions& options, uint64_t lutKey) {
+    // The CPU baker mirrors the shaders but does not round exactly like them, so the backend is part of the keys.
+    // Half or float readbacks give the same maps and are left out.
+    _envSeed = hashValue(BAKE_CACHE_VERSION, FNV_OFFSET_BASIS);
+    _envSeed = hashValue(options.useCPU ? 1 : 0, _envSeed);
+    _envSeed = hashValue(options.envRes, _envSeed);
+    _envSeed = hashValue(options.areaFilter ? 1 : 0, _envSeed);
+    _envSeed = hashFile("shaders/convolution.vs", _envSeed);
+    _envSeed = hashFile("shaders/convolution_layered.vs", _envSeed);
+    _envSeed = hashFile("shaders/convolution_layered.gs", _envSeed);
+    _envSeed = hashFile("shaders/equirectangular.fs", _envSeed);
+    // A reused environment map is not saved again, so it must already be in the output format
+    _envSeed = hashValue((unsigned int)options.outputFormat, _envSeed);
+    _envSeed = hashValue((unsigned int)options.bc6hQuality, _envSeed);
+    _envSeed = hashValue(options.bc3 ? 1 : 0, _envSeed);
+    // Bundles hold the environment map too, and there is no env.dds to bake from
+    _envSeed = hashValue(options.bundle ? 1 : 0, _envSeed);
+    if (options.bundle)
+        _envSeed = hash(&lutKey, sizeof(lutKey), _envSeed);
+
+    _mapsSeed = hashValue(options.irradianceRes, FNV_OFFSET_BASIS);
+    _mapsSeed = hashValue(options.prefilterRes, _mapsSeed);
+    _mapsSeed = hashValue(options.prefilterLevels, _mapsSeed);
+    _mapsSeed = hashValue(options.prefilterSamples, _mapsSeed);
+    _mapsSeed = hashValue((unsigned int)options.irradiance, _mapsSeed);
+    _mapsSeed = hashValue(options.lightSamples, _mapsSeed);
+    _mapsSeed = hashFile("shaders/irradiance.fs", _mapsSeed);
+    _mapsSeed = hashFile("shaders/irradiance_mis.fs", _mapsSeed);
+    _mapsSeed = hashFile("shaders/prefilter.fs", _mapsSeed);
+    // Compute shaders sample the same directions but sum them in another order
+    _mapsSeed = hashValue(options.computeShaders ? 1 : 0, _mapsSeed);
+    _mapsSeed = hashFile("shaders/irradiance.comp", _mapsSeed);
+    _mapsSeed = hashFile("shaders/irradiance_mis.comp", _mapsSeed);
+    _mapsSeed = hashFile("shaders/prefilter.comp", _mapsSeed);
+    _mapsSeed = hashFile("shaders/irradiance_array.comp", _mapsSeed);
+    _mapsSeed = hashFile("shaders/prefilter_array.comp", _mapsSeed);
+}
+
+BakeKeys BakeCache::keys(const std::vector<unsigned char>& file) const {
+    BakeKeys keys;
+    keys.env = hash(file.data(), file.size(), _envSeed);
+    keys.maps = hash(&keys.env, sizeof(keys.env), _mapsSeed);
+    return keys;
+}
+
+BakeKeys BakeCache::arrayKeys(const std::vector<std::string>& names, const std::vector<BakeKeys>& layers) {
+    // The layer count and the name lengths keep different splits of the same bytes apart
+    BakeKeys keys;
+    keys.env = hashValue((unsigned int)layers.size(), FNV_OFFSET_BASIS);
+    keys.maps = keys.env;
+    for (size_t i = 0; i < layers.size(); i++) {
+        uint64_t name = hash(names[i].data(), names[i].size(), hashValue((unsigned int)names[i].size(), FNV_OFFSET_BASIS));
+        keys.env = hash(&name, sizeof(name), keys.env);
+        keys.env = hash(&layers[i].env, sizeof(layers[i].env), keys.env);
+        keys.maps = hash(&name, sizeof(name), keys.maps);
+        keys.maps = hash(&layers[i].maps, sizeof(layers[i].maps), keys.maps);
+    }
+    return keys;
+}
+
+bool BakeCache::load(const std::string& folder, BakeKeys& keys) {
+    std::ifstream file(manifestPath(folder));
+    if (file.fail())
+        return false;
+
+    std::string envLabel, mapsLabel;
+    file >> envLabel >> std::hex >> keys.env >> mapsLabel >> keys.maps;
+    return !file.fail() && envLabel == "env" && mapsLabel == "maps";
+}
+
+bool BakeCache::save(const std::string& folder, const BakeKeys& keys) {
+    std::ofstream file(manifestPath(folder), std::ios_base::out | std::ios_base::trunc);
+    if (file.fail())
+        return false;
+
+    file << std::hex << "env " << keys.env << "\n" << "maps " << keys.maps << "\n";
+    return !file.fail();
+}
+
+void BakeCache::invalidate(const std::string& folder) {
+    std::remove(manifestPath(folder).c_str());
+}
+
+uint64_t BakeCache::lutKey(unsigned int size, unsigned int sampleCount) {
+    uint64_t key = hashValue(BAKE_CACHE_VERSION, FNV_OFFSET_BASIS);
+    key = hashValue(size, key);
+    return hashValue(sampleCount, key);
+}
+
+bool BakeCache::loadLUT(const std::string& folder, uint64_t& key) {
+    std::ifstream file(manifestPath(folder, LUT_MANIFEST_NAME));
+    if (file.fail())
+        return false;
+
+    std::string label;
+    file >> label >> std::hex >> key;
+    return !file.fail() && label == "lut";
+}
+
+bool BakeCache::saveLUT(const std::string& folder, uint64_t key) {
+    std::ofstream file(manifestPath(folder, LUT_MANIFEST_NAME), std::ios_base::out | std::ios_base::trunc);
+    if (file.fail())
+        return false;
+
+    file << std::hex << "lut " << key << "\n";
+    return !file.fail();
+}
+
+void BakeCache::invalidateLUT(const std::string& folder) {
+    std::remove(manifestPath(folder, LUT_MANIFEST_NAME).c_str());
+}
@@ -0,0 +1,48 @@
+#ifndef __XGP_BAKECACHE_H__
+#define __XGP_BAKECACHE_H__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <Bake.h>
+
+// Content hashes identifying a bake job. env covers everything the environment map
+// depends on (input bytes, its resolution, backend and shaders), maps extends it with
+// the parameters and shaders of the irradiance and prefilter passes.
+struct BakeKeys {
+	uint64_t env = 0;
+	uint64_t maps = 0;
+};
+
+// Remembers which job produced the files of an output folder, in a small manifest
+// written next to them once they are all saved. A job whose keys match the manifest
+// can be skipped, and one whose env key matches can bake from the saved env.dds.
+class BakeCache {
+public:
+	// Hashes the options and shader sources once for the whole batch. lutKey identifies
+	// the BRDF LUT that probe bundles embed, it is ignored without BakeOptions::bundle.
+	BakeCache(const BakeOptions& options, uint64_t lutKey);
+
+	BakeKeys keys(const std::vector<unsigned char>& file) const;
+	// Keys of a cubemap array, from the name and keys of every layer in order
+	static BakeKeys arrayKeys(const std::vector<std::string>& names, const std::vector<BakeKeys>& layers);
+
+	static bool load(const std::string& folder, BakeKeys& keys);
+	static bool save(const std::string& folder, const BakeKeys& keys);
+	// Removes the manifest before the files of a folder are rewritten, so that an
+	// interrupted save is never mistaken for a complete one
+	static void invalidate(const std::string& folder);
+
+	// The BRDF LUT does not depend on any image, it gets its own key and manifest
+	static uint64_t lutKey(unsigned int size, unsigned int sampleCount);
+	static bool loadLUT(const std::string& folder, uint64_t& key);
+	static bool saveLUT(const std::string& folder, uint64_t key);
+	static void invalidateLUT(const std::string& folder);
+
+private:
+	uint64_t _envSeed;
+	uint64_t _mapsSeed;
+};
+
+#endif
@@ -0,0 +1,795 @@
+#include "Baker.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <CPUBaker.h>
+#include <GGXSamples.h>
+#include <Half.h>
+#include <LightSampler.h>
+#include <Shader.h>
+#include <Utils.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+    GLuint loadProgram(const std::string& name, const ShaderSource& vertexShader, const ShaderSource* geometryShader, const std::string& fragmentPath) {
+        ShaderSource fragmentShader = ShaderSource(GL_FRAGMENT_SHADER, fragmentPath);
+        Shader shader = Shader(name);
+        shader.addShader(vertexShader);
+        if (geometryShader)
+            shader.addShader(*geometryShader);
+        shader.addShader(fragmentShader);
+        if (!shader.link())
+            Utils::throwError("ERROR: Failed to build program: " + name);
+        return shader.id();
+    }
+
+    GLuint loadComputeProgram(const std::string& name, const std::string& computePath) {
+        ShaderSource computeShader = ShaderSource(GL_COMPUTE_SHADER, computePath);
+        Shader shader = Shader(name);
+        shader.addShader(computeShader);
+        if (!shader.link())
+            Utils::throwError("ERROR: Failed to build program: " + name);
+        return shader.id();
+    }
+
+    // Matches local_size_x and local_size_y of the compute shaders
+    const unsigned int COMPUTE_GROUP_SIZE = 8;
+}
+
+Baker::Baker(const BakeOptions& options)
+    : _options(options), _irradianceComp(0), _prefilterComp(0), _irradianceArrayComp(0), _prefilterArrayComp(0),
+      _arrayLayers(0), _maxArrayLayers(0), _envArray(0), _irradianceArray(0), _prefilterArray(0),
+      _cosineSamplesBuffer(0), _cosineSamples(0), _lightSamplesBuffer(0), _lightSamples(0), _lightSampleCount(0), _lightMap(0),
+      _cubeVAO(0), _cubeVBO(0) {
+
+    // Load shaders once, they are shared by every image.
+    // Layered rendering draws 6 instances of the cube, the geometry shader sends each one to its face.
+    std::unique_ptr<ShaderSource> convolutionVS, convolutionGS;
+    if (_options.layeredRendering) {
+        convolutionVS.reset(new ShaderSource(GL_VERTEX_SHADER, "shaders/convolution_layered.vs"));
+        convolutionGS.reset(new ShaderSource(GL_GEOMETRY_SHADER, "shaders/convolution_layered.gs"));
+    }
+    else {
+        convolutionVS.reset(new ShaderSource(GL_VERTEX_SHADER, "shaders/convolution.vs"));
+    }
+    _equirectangularToCubemapShdr = loadProgram("equirectangularToCubemapShdr", *convolutionVS, convolutionGS.get(), "shaders/equirectangular.fs");
+    // Light sampling replaces the fixed grid of the irradiance convolution altogether
+    const char* irradianceName = _options.lightSamples != 0 ? "irradiance_mis" : "irradiance";
+    _irradianceShdr = loadProgram("irradianceShdr", *convolutionVS, convolutionGS.get(), std::string("shaders/") + irradianceName + ".fs");
+    _prefilterShdr = loadProgram("prefilterShdr", *convolutionVS, convolutionGS.get(), "shaders/prefilter.fs");
+
+    // Compute shaders need GL 4.3 on top of the 3.3 the context was asked for
+    if (_options.computeShaders && !GLEW_VERSION_4_3) {
+        std::cout << "[WARNING] OpenGL 4.3 is not supported, falling back to rendering the maps" << std::endl;
+        _options.computeShaders = false;
+    }
+    if (_options.computeShaders) {
+        _irradianceComp = loadComputeProgram("irradianceComp", std::string("shaders/") + irradianceName + ".comp");
+        _prefilterComp = loadComputeProgram("prefilterComp", "shaders/prefilter.comp");
+        // Batches of cubemap arrays, see bake(const std::vector<const HDRImage*>&)
+        if (_options.lightSamples == 0) {
+            _irradianceArrayComp = loadComputeProgram("irradianceArrayComp", "shaders/irradiance_array.comp");
+            _prefilterArrayComp = loadComputeProgram("prefilterArrayComp", "shaders/prefilter_array.comp");
+            GLint maxLayers;
+            glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+            _maxArrayLayers = std::max(1, maxLayers / 6);
+        }
+    }
+
+    // Setup framebuffer. Only the per-face path has a depth buffer: a cube seen from its center
+    // never overlaps itself, and a layered framebuffer would need a layered depth texture.
+    glGenFramebuffers(1, &_captureFBO);
+    glGenRenderbuffers(1, &_captureRBO);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, _captureFBO);
+    if (!_options.layeredRendering) {
+        glBindRenderbuffer(GL_RENDERBUFFER, _captureRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, _options.envRes, _options.envRes);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, _captureRBO);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // Setup cubemaps, their resolutions never change so every image renders into the same ones
+    _envCubemap = createCubemap(_options.envRes, GL_LINEAR_MIPMAP_LINEAR); // enable pre-filter mipmap sampling (combatting visible dots artifact)
+    // Allocates its mip chain: glCopyImageSubData needs a complete texture before the first image generates them
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    // Image units only take 1, 2 or 4 components formats, the readback still downloads RGB
+    GLenum mapsFormat = _options.computeShaders ? GL_RGBA16F : GL_RGB16F;
+    _irradianceMap = createCubemap(_options.irradianceRes, GL_LINEAR, mapsFormat);
+    _prefilterMap = createCubemap(_options.prefilterRes, GL_LINEAR_MIPMAP_LINEAR, mapsFormat);
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+
+    createPrefilterSamples();
+
+    if (_options.lightSamples != 0) {
+        std::vector<glm::vec4> cosineSamples = LightSampler::cosineSamples(_options.lightSamples);
+        createSampleBuffer(_cosineSamplesBuffer, _cosineSamples, cosineSamples.data(), cosineSamples.size(), GL_STATIC_DRAW);
+        createSampleBuffer(_lightSamplesBuffer, _lightSamples, nullptr, _options.lightSamples, GL_DYNAMIC_DRAW);
+
+        // Read texel by texel like LightSampler::evaluate()
+        _lightMap = createCubemap(std::max(1u, _options.envRes >> LightSampler::level(_options.envRes)), GL_NEAREST, GL_RGBA32F);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+
+    // Setup readback buffers, sized for the levels that are downloaded. The whole
+    // environment mip chain is saved, like the CPU backend does.
+    _envReadback.buffer = createPackBuffer(_options.envRes, (unsigned int)gli::levels(gli::extent2d(_options.envRes, _options.envRes)));
+    _irradianceReadback.buffer = createPackBuffer(_options.irradianceRes, 1);
+    _prefilterReadback.buffer = createPackBuffer(_options.prefilterRes, _options.prefilterLevels);
+
+    // Setup view + proj matrices
+    _captureProjection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
+    _captureViews[0] = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f));
+    _captureViews[1] = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(-1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f));
+    _captureViews[2] = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f,  1.0f,  0.0f), glm::vec3(0.0f,  0.0f,  1.0f));
+    _captureViews[3] = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f,  0.0f), glm::vec3(0.0f,  0.0f, -1.0f));
+    _captureViews[4] = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f,  0.0f,  1.0f), glm::vec3(0.0f, -1.0f,  0.0f));
+    _captureViews[5] = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f,  0.0f, -1.0f), glm::vec3(0.0f, -1.0f,  0.0f));
+
+    // The matrices never change, set them once per program
+    for (GLuint program : { _equirectangularToCubemapShdr, _irradianceShdr, _prefilterShdr }) {
+        glUseProgram(program);
+        glUniformMatrix4fv(glGetUniformLocation(program, "projection"), 1, GL_FALSE, glm::value_ptr(_captureProjection));
+        if (_options.layeredRendering)
+            glUniformMatrix4fv(glGetUniformLocation(program, "views"), 6, GL_FALSE, glm::value_ptr(_captureViews[0]));
+    }
+    glUseProgram(0);
+
+    Utils::checkOpenGLError("ERROR: Failed to initialize baker");
+}
+
+Baker::~Baker() {
+    glDeleteProgram(_equirectangularToCubemapShdr);
+    glDeleteProgram(_irradianceShdr);
+    glDeleteProgram(_prefilterShdr);
+    if (_options.computeShaders) {
+        glDeleteProgram(_irradianceComp);
+        glDeleteProgram(_prefilterComp);
+        glDeleteProgram(_irradianceArrayComp);
+        glDeleteProgram(_prefilterArrayComp);
+    }
+    deleteArrays();
+
+    glDeleteFramebuffers(1, &_captureFBO);
+    glDeleteRenderbuffers(1, &_captureRBO);
+
+    glDeleteTextures(1, &_envCubemap);
+    glDeleteTextures(1, &_irradianceMap);
+    glDeleteTextures(1, &_prefilterMap);
+
+    glDeleteTextures(1, &_prefilterSamples);
+    glDeleteBuffers(1, &_prefilterSamplesBuffer);
+
+    // Zero names are silently ignored when light sampling is off
+    glDeleteTextures(1, &_cosineSamples);
+    glDeleteBuffers(1, &_cosineSamplesBuffer);
+    glDeleteTextures(1, &_lightSamples);
+    glDeleteBuffers(1, &_lightSamplesBuffer);
+    glDeleteTextures(1, &_lightMap);
+
+    glDeleteBuffers(1, &_envReadback.buffer);
+    glDeleteBuffers(1, &_irradianceReadback.buffer);
+    glDeleteBuffers(1, &_prefilterReadback.buffer);
+
+    if (_cubeVAO != 0) {
+        glDeleteVertexArrays(1, &_cubeVAO);
+        glDeleteBuffers(1, &_cubeVBO);
+    }
+}
+
+GLuint Baker::createCubemap(unsigned int size, GLenum minFilter, GLenum internalFormat) {
+    GLuint cubemap;
+    glGenTextures(1, &cubemap);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap);
+    for (unsigned int i = 0; i < 6; ++i)
+    {
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, internalFormat, size, size, 0, internalFormat == GL_RGBA16F || internalFormat == GL_RGBA32F ? GL_RGBA : GL_RGB, GL_FLOAT, nullptr);
+    }
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, minFilter);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return cubemap;
+}
+
+GLuint Baker::createCubemapArray(unsigned int size, unsigned int levels, unsigned int layers, GLenum minFilter, GLenum internalFormat) {
+    GLuint cubemapArray;
+    glGenTextures(1, &cubemapArray);
+    glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, cubemapArray);
+    glTexStorage3D(GL_TEXTURE_CUBE_MAP_ARRAY, levels, internalFormat, size, size, 6 * layers);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MIN_FILTER, minFilter);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return cubemapArray;
+}
+
+void Baker::createArrays(unsigned int layers) {
+    if (layers == _arrayLayers)
+        return;
+    deleteArrays();
+    _arrayLayers = layers;
+
+    // Same formats and levels as the cubemaps, the environment layers are copied from _envCubemap
+    unsigned int envLevels = (unsigned int)gli::levels(gli::extent2d(_options.envRes, _options.envRes));
+    _envArray = createCubemapArray(_options.envRes, envLevels, layers, GL_LINEAR_MIPMAP_LINEAR, GL_RGB16F);
+    _irradianceArray = createCubemapArray(_options.irradianceRes, 1, layers, GL_LINEAR, GL_RGBA16F);
+    _prefilterArray = createCubemapArray(_options.prefilterRes, _options.prefilterLevels, layers, GL_LINEAR_MIPMAP_LINEAR, GL_RGBA16F);
+
+    _envArrayReadback.buffer = createPackBuffer(_options.envRes, envLevels, layers);
+    _irradianceArrayReadback.buffer = createPackBuffer(_options.irradianceRes, 1, layers);
+    _prefilterArrayReadback.buffer = createPackBuffer(_options.prefilterRes, _options.prefilterLevels, layers);
+}
+
+void Baker::deleteArrays() {
+    // Zero names are silently ignored before the first batch
+    glDeleteTextures(1, &_envArray);
+    glDeleteTextures(1, &_irradianceArray);
+    glDeleteTextures(1, &_prefilterArray);
+    glDeleteBuffers(1, &_envArrayReadback.buffer);
+    glDeleteBuffers(1, &_irradianceArrayReadback.buffer);
+    glDeleteBuffers(1, &_prefilterArrayReadback.buffer);
+    _arrayLayers = 0;
+}
+
+GLuint Baker::createPackBuffer(unsigned int size, unsigned int levels, unsigned int layers) {
+    GLsizeiptr bytes = 0;
+    for (unsigned int mip = 0; mip < levels; ++mip) {
+        GLsizeiptr mipRes = std::max(1u, size >> mip);
+        bytes += 6 * layers * 3 * (_options.halfReadback ? sizeof(glm::uint16) : sizeof(float)) * mipRes * mipRes;
+    }
+
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+    glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return buffer;
+}
+
+void Baker::createPrefilterSamples() {
+    // The tables only depend on the roughness of each level, the same ones serve every image
+    std::vector<glm::vec4> samples;
+    for (unsigned int mip = 0; mip < _options.prefilterLevels; ++mip) {
+        std::vector<glm::vec4> levelSamples = GGXSamples::level(_options, mip);
+        _prefilterSampleOffsets.push_back((GLint)samples.size());
+        _prefilterSampleCounts.push_back((GLint)levelSamples.size());
+        samples.insert(samples.end(), levelSamples.begin(), levelSamples.end());
+    }
+
+    createSampleBuffer(_prefilterSamplesBuffer, _prefilterSamples, samples.data(), samples.size(), GL_STATIC_DRAW);
+}
+
+void Baker::createSampleBuffer(GLuint& buffer, GLuint& texture, const glm::vec4* samples, size_t size, GLenum usage) {
+    // A texture buffer rather than a uniform block: up to 4096 vec4 per level are well over
+    // the 16KB uniform blocks are guaranteed
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, size * sizeof(glm::vec4), samples, usage);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void Baker::uploadLights() {
+    // The distribution is built on the CPU: wait for the environment level it is built from
+    unsigned int level = LightSampler::level(_options.envRes);
+    unsigned int size = std::max(1u, _options.envRes >> level);
+    size_t faceTexels = (size_t)size * size;
+    std::vector<float> rgb(6 * 3 * faceTexels);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, _envCubemap);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    for (unsigned int face = 0; face < 6; ++face)
+        glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGB, GL_FLOAT, rgb.data() + face * 3 * faceTexels);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+    LightSampler lights(rgb.data(), size);
+    std::vector<glm::vec4> samples = lights.samples(_options.lightSamples);
+    _lightSampleCount = (GLint)samples.size();
+    if (!samples.empty()) {
+        glBindBuffer(GL_TEXTURE_BUFFER, _lightSamplesBuffer);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, samples.size() * sizeof(glm::vec4), samples.data());
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    // A black environment has no map, its texels are all zero
+    std::vector<glm::vec4> map = lights.empty() ? std::vector<glm::vec4>(6 * faceTexels, glm::vec4(0.0f)) : lights.map();
+    glBindTexture(GL_TEXTURE_CUBE_MAP, _lightMap);
+    for (unsigned int face = 0; face < 6; ++face)
+        glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, 0, 0, size, size, GL_RGBA, GL_FLOAT, map.data() + face * faceTexels);
+}
+
+void Baker::beginReadback(Readback& readback, GLenum target, GLuint texture, unsigned int size, unsigned int levels,
+                          const std::vector<gli::texture_cube*>& cubemaps, const std::vector<SphericalHarmonics*>& radianceSH) {
+    readback.size = size;
+    readback.levels = levels;
+    readback.cubemaps = cubemaps;
+    readback.radianceSH = radianceSH;
+    readback.type = _options.halfReadback ? GL_HALF_FLOAT : GL_FLOAT;
+
+    // With a pack buffer bound, glGetTexImage takes an offset and returns immediately.
+    // Rows are packed tightly so half float faces match the RGB16 gli layout byte for byte.
+    // A cubemap array level comes in one call, its layer-faces one after the other.
+    glBindTexture(target, texture);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    size_t texelSize = 3 * (readback.type == GL_HALF_FLOAT ? sizeof(glm::uint16) : sizeof(float));
+    size_t offset = 0;
+    for (unsigned int mip = 0; mip < levels; ++mip) {
+        size_t mipRes = std::max(1u, size >> mip);
+        if (target == GL_TEXTURE_CUBE_MAP_ARRAY) {
+            glGetTexImage(GL_TEXTURE_CUBE_MAP_ARRAY, mip, GL_RGB, readback.type, (void*)offset);
+            offset += 6 * cubemaps.size() * texelSize * mipRes * mipRes;
+            continue;
+        }
+        for (int face = 0; face < 6; face++) {
+            glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, mip, GL_RGB, readback.type, (void*)offset);
+            offset += texelSize * mipRes * mipRes;
+        }
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void Baker::endReadback(Readback& readback) {
+    GLenum status;
+    do {
+        status = glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+    } while (status == GL_TIMEOUT_EXPIRED);
+    glDeleteSync(readback.fence);
+    readback.fence = nullptr;
+    if (status == GL_WAIT_FAILED)
+        Utils::throwError("ERROR: Failed to wait for cubemap readback");
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    const unsigned char* data = (const unsigned char*)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+    if (!data)
+        Utils::throwError("ERROR: Failed to map cubemap readback buffer");
+
+    for (unsigned int mip = 0; mip < readback.levels; ++mip) {
+        unsigned int mipRes = std::max(1u, readback.size >> mip);
+        size_t texelCount = (size_t)mipRes * mipRes;
+        for (size_t layer = 0; layer < readback.cubemaps.size(); layer++) {
+            gli::texture_cube* cubemap = readback.cubemaps[layer];
+            SphericalHarmonics* radianceSH = mip == 0 && !readback.radianceSH.empty() ? readback.radianceSH[layer] : nullptr;
+            for (int face = 0; face < 6; face++) {
+                if (readback.type == GL_HALF_FLOAT) {
+                    if (radianceSH) {
+                        radianceSH->addFace(face, (const glm::uint16*)data, mipRes);
+                    }
+                    std::memcpy(cubemap->data(0, face, mip), data, cubemap->size(mip));
+                    data += 3 * sizeof(glm::uint16) * texelCount;
+                    continue;
+                }
+
+                const float* texData = (const float*)data;
+                if (radianceSH) {
+                    radianceSH->addFace(face, texData, mipRes);
+                }
+                Half::storeFace(*cubemap, face, mip, texData);
+                data += 3 * sizeof(float) * texelCount;
+            }
+        }
+    }
+
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+BakeResult Baker::bake(const HDRImage& image, const BakeSink& sink) {
+    BakeResult result;
+
+    renderEnvironment(image);
+
+    // then let OpenGL generate mipmaps from first mip face (combatting visible dots artifact)
+    glBindTexture(GL_TEXTURE_CUBE_MAP, _envCubemap);
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+
+    bakeMaps(result, sink, true, SphericalHarmonics());
+    return result;
+}
+
+std::vector<BakeResult> Baker::bake(const std::vector<const HDRImage*>& images, const BakeSink& sink) {
+    std::vector<BakeResult> results(images.size());
+
+    // The array programs are only loaded for compute shaders without light sampling
+    if (_irradianceArrayComp == 0) {
+        for (size_t i = 0; i < images.size(); i++) {
+            BakeSink layerSink;
+            if (sink) {
+                layerSink = [&sink, i](size_t, BakeMap map, gli::texture_cube&& cubemap) {
+                    sink(i, map, std::move(cubemap));
+                };
+            }
+            results[i] = bake(*images[i], layerSink);
+        }
+        return results;
+    }
+
+    for (size_t first = 0; first < images.size(); first += _maxArrayLayers) {
+        unsigned int layers = (unsigned int)std::min<size_t>(_maxArrayLayers, images.size() - first);
+        createArrays(layers);
+
+        // The environments are projected one by one, then copied into their layer
+        for (unsigned int layer = 0; layer < layers; layer++) {
+            renderEnvironment(*images[first + layer]);
+            glCopyImageSubData(_envCubemap, GL_TEXTURE_CUBE_MAP, 0, 0, 0, 0,
+                               _envArray, GL_TEXTURE_CUBE_MAP_ARRAY, 0, 0, 0, 6 * layer,
+                               _options.envRes, _options.envRes, 6);
+        }
+        glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, _envArray);
+        glGenerateMipmap(GL_TEXTURE_CUBE_MAP_ARRAY);
+
+        bakeLayers(results.data() + first, layers, sink, first);
+    }
+    return results;
+}
+
+void Baker::renderEnvironment(const HDRImage& image) {
+    if (_options.areaFilter) {
+        // The summed-area table lives on the CPU, upload the projected faces instead of the image
+        CPUCubemap envCubemap = CPUBaker(_options).equirectangularToCubemap(image.data(), image.width(), image.height());
+        std::vector<float> face(3 * (size_t)_options.envRes * _options.envRes);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, _envCubemap);
+        for (unsigned int i = 0; i < 6; ++i) {
+            envCubemap.readFace(i, 0, face.data());
+            glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, 0, 0, _options.envRes, _options.envRes, GL_RGB, GL_FLOAT, face.data());
+        }
+        return;
+    }
+
+    // Upload image, it is only needed by the first pass
+    GLuint hdrTexture;
+    glGenTextures(1, &hdrTexture);
+    glBindTexture(GL_TEXTURE_2D, hdrTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, image.width(), image.height(), 0, GL_RGB, GL_FLOAT, image.data());
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // Convert Equirectangular to Cubemap
+    glUseProgram(_equirectangularToCubemapShdr);
+    glUniform1i(glGetUniformLocation(_equirectangularToCubemapShdr, "equirectangularMap"), 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, hdrTexture);
+
+    renderCubemap(_equirectangularToCubemapShdr, _envCubemap, 0, _options.envRes);
+    glDeleteTextures(1, &hdrTexture);
+}
+
+BakeResult Baker::bake(const gli::texture_cube& envMap, const BakeSink& sink) {
+    GLI_ASSERT(envMap.format() == gli::FORMAT_RGB16_SFLOAT_PACK16 && envMap.extent().x == (int)_options.envRes);
+    BakeResult result;
+
+    // Upload the first level, the others are regenerated exactly like after the equirectangular pass
+    glBindTexture(GL_TEXTURE_CUBE_MAP, _envCubemap);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (unsigned int i = 0; i < 6; ++i)
+    {
+        glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, 0, 0, _options.envRes, _options.envRes, GL_RGB, GL_HALF_FLOAT, envMap.data(0, i, 0));
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+
+    SphericalHarmonics radianceSH;
+    if (_options.irradiance != IrradianceMode::Convolution) {
+        for (unsigned int face = 0; face < 6; face++)
+            radianceSH.addFace(face, envMap.data<glm::uint16>(0, face, 0), _options.envRes);
+    }
+
+    bakeMaps(result, sink, false, radianceSH);
+    return result;
+}
+
+void Baker::bakeMaps(BakeResult& result, const BakeSink& sink, bool readEnvironment, SphericalHarmonics radianceSH) {
+    // Every pass is downloaded asynchronously: the downloads are only consumed
+    // once all passes are queued, so the CPU encodes one while the GPU renders the next
+    bool projectSH = _options.irradiance != IrradianceMode::Convolution;
+    if (readEnvironment) {
+        result.envMap = gli::texture_cube(gli::FORMAT_RGB16_SFLOAT_PACK16, gli::extent2d(_options.envRes, _options.envRes));
+        beginReadback(_envReadback, GL_TEXTURE_CUBE_MAP, _envCubemap, _options.envRes, (unsigned int)result.envMap.levels(), { &result.envMap },
+                      projectSH ? std::vector<SphericalHarmonics*>{ &radianceSH } : std::vector<SphericalHarmonics*>());
+    }
+
+    if (_options.lightSamples != 0) {
+        uploadLights();
+
+        // Light sampling units, after the environment and the GGX samples
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_BUFFER, _lightSamples);
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, _lightMap);
+        glActiveTexture(GL_TEXTURE4);
+        glBindTexture(GL_TEXTURE_BUFFER, _cosineSamples);
+    }
+
+    if (_options.irradiance == IrradianceMode::Convolution) {
+        // Generate irradiance data
+        GLuint program = _options.computeShaders ? _irradianceComp : _irradianceShdr;
+        glUseProgram(program);
+        if (_options.lightSamples != 0) {
+            glUniform1i(glGetUniformLocation(program, "lightSamples"), 2);
+            glUniform1i(glGetUniformLocation(program, "lightMap"), 3);
+            glUniform1i(glGetUniformLocation(program, "cosineSamples"), 4);
+            glUniform1i(glGetUniformLocation(program, "lightSampleCount"), _lightSampleCount);
+            glUniform1i(glGetUniformLocation(program, "cosineSampleCount"), (GLint)_options.lightSamples);
+        }
+        else {
+            glUniform1i(glGetUniformLocation(program, "environmentMap"), 0);
+        }
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, _envCubemap);
+
+        if (_options.computeShaders) {
+            // The level the fragment shader derivatives select when rasterizing the map,
+            // ignored by the light sampling version
+            float lod = std::log2((float)_options.envRes / (float)_options.irradianceRes);
+            glUniform1f(glGetUniformLocation(program, "lod"), std::max(0.0f, lod));
+            dispatchCubemap(_irradianceMap, 0, _options.irradianceRes);
+            glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+        }
+        else {
+            renderCubemap(_irradianceShdr, _irradianceMap, 0, _options.irradianceRes);
+        }
+
+        result.irradianceMap = gli::texture_cube(gli::FORMAT_RGB16_SFLOAT_PACK16, gli::extent2d(_options.irradianceRes, _options.irradianceRes));
+        beginReadback(_irradianceReadback, GL_TEXTURE_CUBE_MAP, _irradianceMap, _options.irradianceRes, 1, { &result.irradianceMap });
+    }
+
+    // Generate prefilter cubemap
+    GLuint prefilterProgram = _options.computeShaders ? _prefilterComp : _prefilterShdr;
+    glUseProgram(prefilterProgram);
+    glUniform1i(glGetUniformLocation(prefilterProgram, "environmentMap"), 0);
+    glUniform1i(glGetUniformLocation(prefilterProgram, "samples"), 1);
+    // Set even without light sampling, samplers of different types can't share unit 0
+    glUniform1i(glGetUniformLocation(prefilterProgram, "lightSamples"), 2);
+    glUniform1i(glGetUniformLocation(prefilterProgram, "lightMap"), 3);
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_BUFFER, _prefilterSamples);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, _envCubemap);
+
+    // Compute dispatches of the levels are independent, they are queued back to back
+    // with a single barrier before the readback
+    for (unsigned int mip = 0; mip < _options.prefilterLevels; ++mip)
+    {
+        glUniform1i(glGetUniformLocation(prefilterProgram, "sampleOffset"), _prefilterSampleOffsets[mip]);
+        glUniform1i(glGetUniformLocation(prefilterProgram, "sampleCount"), _prefilterSampleCounts[mip]);
+        if (_options.lightSamples != 0) {
+            // The first level is a plain downsample and keeps its single sample
+            glUniform1i(glGetUniformLocation(prefilterProgram, "lightSampleCount"), mip == 0 ? 0 : _lightSampleCount);
+            glUniform1f(glGetUniformLocation(prefilterProgram, "roughness"), mip == 0 ? 0.0f : (float)mip / (float)(_options.prefilterLevels - 1));
+            glUniform1f(glGetUniformLocation(prefilterProgram, "ggxSampleCount"), (float)GGXSamples::count(_options, mip));
+        }
+        if (_options.computeShaders)
+            dispatchCubemap(_prefilterMap, mip, std::max(1u, _options.prefilterRes >> mip));
+        else
+            renderCubemap(_prefilterShdr, _prefilterMap, mip, std::max(1u, _options.prefilterRes >> mip));
+    }
+    if (_options.computeShaders)
+        glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+    result.prefilterMap = gli::texture_cube(gli::FORMAT_RGB16_SFLOAT_PACK16, gli::extent2d(_options.prefilterRes, _options.prefilterRes), _options.prefilterLevels);
+    beginReadback(_prefilterReadback, GL_TEXTURE_CUBE_MAP, _prefilterMap, _options.prefilterRes, _options.prefilterLevels, { &result.prefilterMap });
+
+    if (readEnvironment) {
+        endReadback(_envReadback);
+        emitMap(sink, 0, BakeMap::Environment, result.envMap);
+    }
+    if (_options.irradiance == IrradianceMode::Convolution) {
+        endReadback(_irradianceReadback);
+    }
+    else {
+        // Evaluated on the CPU while the GPU is still busy prefiltering
+        result.irradianceSH = radianceSH.irradiance();
+        if (_options.irradiance == IrradianceMode::SH) {
+            CPUCubemap irradianceMap = CPUBaker(_options).irradiance(result.irradianceSH);
+            result.irradianceMap = gli::texture_cube(gli::FORMAT_RGB16_SFLOAT_PACK16, gli::extent2d(_options.irradianceRes, _options.irradianceRes));
+            irradianceMap.store(result.irradianceMap);
+        }
+    }
+    if (!result.irradianceMap.empty())
+        emitMap(sink, 0, BakeMap::Irradiance, result.irradianceMap);
+    endReadback(_prefilterReadback);
+    emitMap(sink, 0, BakeMap::Prefilter, result.prefilterMap);
+
+    Utils::checkOpenGLError("ERROR: Failed to bake image");
+}
+
+void Baker::bakeLayers(BakeResult* results, unsigned int layers, const BakeSink& sink, size_t first) {
+    // Same steps as bakeMaps(), with every dispatch covering all the layers
+    bool projectSH = _options.irradiance != IrradianceMode::Convolution;
+    std::vector<SphericalHarmonics> radianceSH(layers);
+    std::vector<gli::texture_cube*> envMaps, irradianceMaps, prefilterMaps;
+    std::vector<SphericalHarmonics*> layerSH;
+    for (unsigned int layer = 0; layer < layers; layer++) {
+        BakeResult& result = results[layer];
+        result.envMap = gli::texture_cube(gli::FORMAT_RGB16_SFLOAT_PACK16, gli::extent2d(_options.envRes, _options.envRes));
+        if (_options.irradiance == IrradianceMode::Convolution)
+            result.irradianceMap = gli::texture_cube(gli::FORMAT_RGB16_SFLOAT_PACK16, gli::extent2d(_options.irradianceRes, _options.irradianceRes));
+        result.prefilterMap = gli::texture_cube(gli::FORMAT_RGB16_SFLOAT_PACK16, gli::extent2d(_options.prefilterRes, _options.prefilterRes), _options.prefilterLevels);
+        envMaps.push_back(&result.envMap);
+        irradianceMaps.push_back(&result.irradianceMap);
+        prefilterMaps.push_back(&result.prefilterMap);
+        if (projectSH)
+            layerSH.push_back(&radianceSH[layer]);
+    }
+    beginReadback(_envArrayReadback, GL_TEXTURE_CUBE_MAP_ARRAY, _envArray, _options.envRes, (unsigned int)envMaps[0]->levels(), envMaps, layerSH);
+
+    if (_options.irradiance == IrradianceMode::Convolution) {
+        glUseProgram(_irradianceArrayComp);
+        glUniform1i(glGetUniformLocation(_irradianceArrayComp, "environmentMap"), 0);
+        float lod = std::log2((float)_options.envRes / (float)_options.irradianceRes);
+        glUniform1f(glGetUniformLocation(_irradianceArrayComp, "lod"), std::max(0.0f, lod));
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, _envArray);
+        dispatchCubemap(_irradianceArray, 0, _options.irradianceRes, layers);
+        glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+        beginReadback(_irradianceArrayReadback, GL_TEXTURE_CUBE_MAP_ARRAY, _irradianceArray, _options.irradianceRes, 1, irradianceMaps);
+    }
+
+    glUseProgram(_prefilterArrayComp);
+    glUniform1i(glGetUniformLocation(_prefilterArrayComp, "environmentMap"), 0);
+    glUniform1i(glGetUniformLocation(_prefilterArrayComp, "samples"), 1);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_BUFFER, _prefilterSamples);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, _envArray);
+    for (unsigned int mip = 0; mip < _options.prefilterLevels; ++mip) {
+        glUniform1i(glGetUniformLocation(_prefilterArrayComp, "sampleOffset"), _prefilterSampleOffsets[mip]);
+        glUniform1i(glGetUniformLocation(_prefilterArrayComp, "sampleCount"), _prefilterSampleCounts[mip]);
+        dispatchCubemap(_prefilterArray, mip, std::max(1u, _options.prefilterRes >> mip), layers);
+    }
+    glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+    beginReadback(_prefilterArrayReadback, GL_TEXTURE_CUBE_MAP_ARRAY, _prefilterArray, _options.prefilterRes, _options.prefilterLevels, prefilterMaps);
+
+    endReadback(_envArrayReadback);
+    for (unsigned int layer = 0; layer < layers; layer++)
+        emitMap(sink, first + layer, BakeMap::Environment, results[layer].envMap);
+    if (_options.irradiance == IrradianceMode::Convolution) {
+        endReadback(_irradianceArrayReadback);
+    }
+    else {
+        // Evaluated on the CPU while the GPU is still busy prefiltering
+        std::vector<SphericalHarmonics> irradianceSH;
+        for (unsigned int layer = 0; layer < layers; layer++) {
+            results[layer].irradianceSH = radianceSH[layer].irradiance();
+            irradianceSH.push_back(results[layer].irradianceSH);
+        }
+        if (_options.irradiance == IrradianceMode::SH) {
+            std::vector<CPUCubemap> irradianceMaps = CPUBaker(_options).irradiance(irradianceSH);
+            for (unsigned int layer = 0; layer < layers; layer++) {
+                results[layer].irradianceMap = gli::texture_cube(gli::FORMAT_RGB16_SFLOAT_PACK16, gli::extent2d(_options.irradianceRes, _options.irradianceRes));
+                irradianceMaps[layer].store(results[layer].irradianceMap);
+            }
+        }
+    }
+    for (unsigned int layer = 0; layer < layers; layer++) {
+        if (!results[layer].irradianceMap.empty())
+            emitMap(sink, first + layer, BakeMap::Irradiance, results[layer].irradianceMap);
+    }
+    endReadback(_prefilterArrayReadback);
+    for (unsigned int layer = 0; layer < layers; layer++)
+        emitMap(sink, first + layer, BakeMap::Prefilter, results[layer].prefilterMap);
+
+    Utils::checkOpenGLError("ERROR: Failed to bake cubemap array");
+}
+
+void Baker::dispatchCubemap(GLuint cubemap, unsigned int level, unsigned int size, unsigned int layers) {
+    // Layered binding exposes the six faces of every layer, the z dimension of the dispatch picks one
+    glBindImageTexture(0, cubemap, level, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+    GLuint groups = (size + COMPUTE_GROUP_SIZE - 1) / COMPUTE_GROUP_SIZE;
+    glDispatchCompute(groups, groups, 6 * layers);
+}
+
+void Baker::renderCubemap(GLuint program, GLuint cubemap, unsigned int level, unsigned int size) {
+    glBindFramebuffer(GL_FRAMEBUFFER, _captureFBO);
+    glViewport(0, 0, size, size); // don't forget to configure the viewport to the capture dimensions.
+
+    if (_options.layeredRendering) {
+        // The whole level is attached at once, a single instanced draw fills its six faces
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, cubemap, level);
+        glClear(GL_COLOR_BUFFER_BIT);
+        renderCube(6);
+    }
+    else {
+        glBindRenderbuffer(GL_RENDERBUFFER, _captureRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+        for (unsigned int i = 0; i < 6; ++i)
+        {
+            glUniformMatrix4fv(glGetUniformLocation(program, "view"), 1, GL_FALSE, glm::value_ptr(_captureViews[i]));
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, cubemap, level);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            renderCube();
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Baker::renderCube(GLsizei instances) {
+    // initialize (if necessary)
+    if (_cubeVAO == 0) {
+        float vertices[] = {
+            // back face
+            -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 0.0f, // bottom-left
+            1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 1.0f, // top-right
+            1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 0.0f, // bottom-right         
+            1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 1.0f, // top-right
+            -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 0.0f, // bottom-left
+            -1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 1.0f, // top-left
+                                                                  // front face
+            -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 0.0f, // bottom-left
+            1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 0.0f, // bottom-right
+            1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 1.0f, // top-right
+            1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 1.0f, // top-right
+            -1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 1.0f, // top-left
+            -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 0.0f, // bottom-left
+                                                                // left face
+            -1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-right
+            -1.0f,  1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 1.0f, // top-left
+            -1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-left
+            -1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-left
+            -1.0f, -1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 0.0f, // bottom-right
+            -1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-right
+            // right face
+            1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-left
+            1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-right
+            1.0f,  1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 1.0f, // top-right         
+            1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-right
+            1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-left
+            1.0f, -1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 0.0f, // bottom-left     
+                                                                // bottom face
+            -1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, // top-right
+            1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 1.0f, // top-left
+            1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 0.0f, // bottom-left
+            1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 0.0f, // bottom-left
+            -1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 0.0f, // bottom-right
+            -1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, // top-right
+            // top face
+            -1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, // top-left
+            1.0f,  1.0f , 1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 0.0f, // bottom-right
+            1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 1.0f, // top-right     
+            1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 0.0f, // bottom-right
+            -1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, // top-left                                                                                                                                                 
+            -1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 0.0f  // bottom-left        
+        };
+        glGenVertexArrays(1, &_cubeVAO);
+        glGenBuffers(1, &_cubeVBO);
+        // fill buffer
+        glBindBuffer(GL_ARRAY_BUFFER, _cubeVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+        // link vertex attributes
+        glBindVertexArray(_cubeVAO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindVertexArray(0);
+    }
+    // render Cube
+    glBindVertexArray(_cubeVAO);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 36, instances);
+    glBindVertexArray(0);
+}
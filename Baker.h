@@ -0,0 +1,141 @@
+#ifndef __XGP_BAKER_H__
+#define __XGP_BAKER_H__
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <Bake.h>
+#include <HDRImage.h>
+
+#include <vector>
+
+// OpenGL baker. Compiles the programs and allocates the capture framebuffer and
+// the output cubemaps once, then reuses them for every image it bakes.
+// Requires a current GL 3.3 context for its whole lifetime.
+class Baker {
+public:
+	Baker(const BakeOptions& options);
+	~Baker();
+
+	Baker(const Baker&) = delete;
+	Baker& operator=(const Baker&) = delete;
+
+	// Each map goes to sink, when given, as soon as its readback lands: the environment
+	// while the GPU is still busy with the other passes
+	BakeResult bake(const HDRImage& image, const BakeSink& sink = BakeSink());
+	// Skips the equirectangular pass and bakes from an environment map baked earlier with
+	// the same options, e.g. loaded back from env.dds. result.envMap is left empty.
+	BakeResult bake(const gli::texture_cube& envMap, const BakeSink& sink = BakeSink());
+	// Bakes the images as the layers of cubemap arrays, each compute dispatch convolving
+	// all of them at once. Rendering and light sampling bake them one after the other.
+	std::vector<BakeResult> bake(const std::vector<const HDRImage*>& images, const BakeSink& sink = BakeSink());
+
+private:
+	// Download of a cubemap or of the layers of a cubemap array into a pixel pack buffer,
+	// guarded by a fence
+	struct Readback {
+		GLuint buffer = 0;
+		GLsync fence = nullptr;
+		GLenum type = GL_FLOAT;
+		unsigned int size = 0;
+		unsigned int levels = 0;
+		// One cubemap per layer, and the projection of each one when radianceSH is not empty
+		std::vector<gli::texture_cube*> cubemaps;
+		std::vector<SphericalHarmonics*> radianceSH;
+	};
+
+	GLuint createCubemap(unsigned int size, GLenum minFilter, GLenum internalFormat = GL_RGB16F);
+	GLuint createCubemapArray(unsigned int size, unsigned int levels, unsigned int layers, GLenum minFilter, GLenum internalFormat);
+	GLuint createPackBuffer(unsigned int size, unsigned int levels, unsigned int layers = 1);
+	// (Re)allocates the arrays and their pack buffers for that many layers
+	void createArrays(unsigned int layers);
+	void deleteArrays();
+	// RGBA32F texture buffer holding samples, or room for size of them when samples is null
+	void createSampleBuffer(GLuint& buffer, GLuint& texture, const glm::vec4* samples, size_t size, GLenum usage);
+	// Uploads the GGX sample tables of every prefilter level into one texture buffer
+	void createPrefilterSamples();
+	// Builds the light sampler of the environment in _envCubemap and uploads its samples and map
+	void uploadLights();
+
+	// Queues the download of the first levels of texture into cubemaps without waiting for the GPU.
+	// target is GL_TEXTURE_CUBE_MAP, or GL_TEXTURE_CUBE_MAP_ARRAY with one cubemap per layer.
+	void beginReadback(Readback& readback, GLenum target, GLuint texture, unsigned int size, unsigned int levels,
+		const std::vector<gli::texture_cube*>& cubemaps, const std::vector<SphericalHarmonics*>& radianceSH = {});
+	// Waits for the download to land, then converts it into the cubemaps given to beginReadback
+	void endReadback(Readback& readback);
+
+	// Projects image into the first level of _envCubemap, without its mipmaps
+	void renderEnvironment(const HDRImage& image);
+
+	// Irradiance and prefilter passes from _envCubemap, readEnvironment also downloads it.
+	// radianceSH holds the projection of the environment when it is not downloaded.
+	void bakeMaps(BakeResult& result, const BakeSink& sink, bool readEnvironment, SphericalHarmonics radianceSH);
+	// Irradiance and prefilter passes of every layer of _envArray, which are all downloaded.
+	// The maps go to sink as the layers first + 0..layers-1.
+	void bakeLayers(BakeResult* results, unsigned int layers, const BakeSink& sink, size_t first);
+
+	// Renders program into the six faces of one level of cubemap, either face by face
+	// or all at once with layered rendering
+	void renderCubemap(GLuint program, GLuint cubemap, unsigned int level, unsigned int size);
+
+	// Runs the compute program in use over the six faces of one level of cubemap, or of
+	// every layer of a cubemap array, bound as image unit 0
+	void dispatchCubemap(GLuint cubemap, unsigned int level, unsigned int size, unsigned int layers = 1);
+
+	void renderCube(GLsizei instances = 1);
+
+	BakeOptions _options;
+
+	GLuint _equirectangularToCubemapShdr;
+	GLuint _irradianceShdr;
+	GLuint _prefilterShdr;
+	GLuint _irradianceComp;
+	GLuint _prefilterComp;
+	GLuint _irradianceArrayComp;
+	GLuint _prefilterArrayComp;
+
+	GLuint _captureFBO;
+	GLuint _captureRBO;
+
+	GLuint _envCubemap;
+	GLuint _irradianceMap;
+	GLuint _prefilterMap;
+
+	// Cubemap arrays of the batches baked by compute, sized for _arrayLayers layers.
+	// Layers are bounded by GL_MAX_ARRAY_TEXTURE_LAYERS / 6.
+	unsigned int _arrayLayers;
+	unsigned int _maxArrayLayers;
+	GLuint _envArray;
+	GLuint _irradianceArray;
+	GLuint _prefilterArray;
+	Readback _envArrayReadback;
+	Readback _irradianceArrayReadback;
+	Readback _prefilterArrayReadback;
+
+	// Tables of every prefilter level one after the other, as RGBA32F texels
+	GLuint _prefilterSamplesBuffer;
+	GLuint _prefilterSamples;
+	std::vector<GLint> _prefilterSampleOffsets;
+	std::vector<GLint> _prefilterSampleCounts;
+
+	// Light sampling, see BakeOptions::lightSamples. The cosine samples of the irradiance pass
+	// serve every image, the light samples and the map are rebuilt for each one.
+	GLuint _cosineSamplesBuffer;
+	GLuint _cosineSamples;
+	GLuint _lightSamplesBuffer;
+	GLuint _lightSamples;
+	GLint _lightSampleCount;
+	// Radiance and face area pdf of every texel, see LightSampler::map()
+	GLuint _lightMap;
+
+	Readback _envReadback;
+	Readback _irradianceReadback;
+	Readback _prefilterReadback;
+
+	GLuint _cubeVAO, _cubeVBO;
+
+	glm::mat4 _captureProjection;
+	glm::mat4 _captureViews[6];
+};
+
+#endif
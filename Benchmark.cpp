@@ -0,0 +1,68 @@
+#include "Benchmark.h"
+
+#include <gli/gli.hpp>
+
+#include <Half.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+    // Best of a few runs, in milliseconds
+    template <typename Func>
+    double timeBest(unsigned int runs, Func func) {
+        double best = 0.0;
+        for (unsigned int i = 0; i < runs; i++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            func();
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+            if (i == 0 || elapsed.count() < best)
+                best = elapsed.count();
+        }
+        return best;
+    }
+}
+
+void Benchmark::halfConversion(unsigned int size) {
+    // HDR-like values over several orders of magnitude
+    std::vector<float> texData(3 * size * size);
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> exponent(-8.0f, 12.0f);
+    for (float& value : texData)
+        value = std::exp2(exponent(rng));
+
+    gli::texture_cube texelLoop(gli::FORMAT_RGB16_SFLOAT_PACK16, gli::extent2d(size, size), 1);
+    gli::texture_cube bulk(gli::FORMAT_RGB16_SFLOAT_PACK16, gli::extent2d(size, size), 1);
+
+    double loopMs = timeBest(5, [&]() {
+        for (int y = 0; y < (int)size; y++) {
+            for (int x = 0; x < (int)size; x++) {
+                unsigned int row = y * size * 3;
+                unsigned int col = x * 3;
+                glm::vec3 texelData = glm::vec3(texData[row + col], texData[row + col + 1], texData[row + col + 2]);
+                texelLoop.store<glm::highp_u16vec3>({ x, y }, 0, 0, gli::packHalf(texelData));
+            }
+        }
+    });
+    double bulkMs = timeBest(5, [&]() {
+        Half::storeFace(bulk, 0, 0, texData.data());
+    });
+
+    // Both round to nearest, but not always the same way on ties
+    const glm::uint16* a = texelLoop.data<glm::uint16>(0, 0, 0);
+    const glm::uint16* b = bulk.data<glm::uint16>(0, 0, 0);
+    size_t mismatches = 0;
+    for (size_t i = 0; i < texData.size(); i++) {
+        if (a[i] != b[i])
+            mismatches++;
+    }
+
+    std::cout << "Half conversion of a " << size << "x" << size << " RGB face:" << std::endl;
+    std::cout << "  per-texel store loop: " << loopMs << " ms" << std::endl;
+    std::cout << "  Half::storeFace:      " << bulkMs << " ms (" << loopMs / bulkMs << "x)" << std::endl;
+    std::cout << "  differing halves:     " << mismatches << " / " << texData.size() << std::endl;
+}
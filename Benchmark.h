@@ -0,0 +1,10 @@
+#ifndef __XGP_BENCHMARK_H__
+#define __XGP_BENCHMARK_H__
+
+// Microbenchmarks of the CPU hot paths, printed to stdout
+namespace Benchmark {
+	// Per-texel packHalf + texture_cube::store() against Half::storeFace() on an env sized face
+	void halfConversion(unsigned int size);
+}
+
+#endif
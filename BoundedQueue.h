@@ -0,0 +1,51 @@
+#ifndef __XGP_BOUNDEDQUEUE_H__
+#define __XGP_BOUNDEDQUEUE_H__
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+// Blocking FIFO between pipeline stages. Producers wait while it holds capacity
+// items, which bounds the memory held by images waiting for the next stage.
+template <typename T>
+class BoundedQueue {
+public:
+	BoundedQueue(size_t capacity) : _capacity(capacity), _closed(false) {}
+
+	// Blocks while the queue is full
+	void push(T value) {
+		std::unique_lock<std::mutex> lock(_mutex);
+		_notFull.wait(lock, [this] { return _items.size() < _capacity; });
+		_items.push_back(std::move(value));
+		_notEmpty.notify_one();
+	}
+
+	// Blocks while the queue is empty. Returns false once it is closed and drained.
+	bool pop(T& value) {
+		std::unique_lock<std::mutex> lock(_mutex);
+		_notEmpty.wait(lock, [this] { return !_items.empty() || _closed; });
+		if (_items.empty())
+			return false;
+		value = std::move(_items.front());
+		_items.pop_front();
+		_notFull.notify_one();
+		return true;
+	}
+
+	// No more items will be pushed, wakes up every waiting consumer
+	void close() {
+		std::lock_guard<std::mutex> lock(_mutex);
+		_closed = true;
+		_notEmpty.notify_all();
+	}
+
+private:
+	size_t _capacity;
+	bool _closed;
+	std::deque<T> _items;
+	std::mutex _mutex;
+	std::condition_variable _notFull;
+	std::condition_variable _notEmpty;
+};
+
+#endif
@@ -0,0 +1,694 @@
+#include "CPUBaker.h"
+
+#include <EquirectSAT.h>
+#include <GGXSamples.h>
+#include <HDRImage.h>
+#include <Half.h>
+#include <LightSampler.h>
+#include <Utils.h>
+
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#define TILE_SIZE 32
+
+// Area filtering halves panoramas wider than this many environment texels, which
+// keeps at least two of their texels across an environment texel at the face centers
+#define AREA_FILTER_WIDTH_RATIO 8
+
+// Mirrors the constant hardcoded in shaders/irradiance.fs
+#define IRRADIANCE_SAMPLE_DELTA 0.025f
+
+static const float PI = 3.14159265359f;
+
+namespace {
+    struct Job {
+        unsigned int face;
+        unsigned int level;
+        unsigned int x0, y0;
+        unsigned int x1, y1;
+    };
+
+    // Splits every face of every requested level into TILE_SIZE x TILE_SIZE jobs
+    std::vector<Job> makeJobs(const CPUCubemap& cubemap, unsigned int levels) {
+        std::vector<Job> jobs;
+        for (unsigned int level = 0; level < levels; level++) {
+            unsigned int size = cubemap.size(level);
+            for (unsigned int face = 0; face < 6; face++) {
+                for (unsigned int y = 0; y < size; y += TILE_SIZE) {
+                    for (unsigned int x = 0; x < size; x += TILE_SIZE) {
+                        jobs.push_back({ face, level, x, y, std::min(x + TILE_SIZE, size), std::min(y + TILE_SIZE, size) });
+                    }
+                }
+            }
+        }
+        return jobs;
+    }
+
+    // Runs texel(layer, dir, level) for the center of every texel of the given levels of
+    // every cubemap, all of the same size, with the jobs of all layers in one parallelFor
+    template <typename TexelFunc>
+    void bakeTexels(std::vector<CPUCubemap>& cubemaps, unsigned int levels, TexelFunc texel) {
+        std::vector<Job> jobs = makeJobs(cubemaps[0], levels);
+        Utils::parallelFor((unsigned int)(cubemaps.size() * jobs.size()), [&](unsigned int j) {
+            unsigned int layer = j / (unsigned int)jobs.size();
+            const Job& job = jobs[j % jobs.size()];
+            CPUCubemap& cubemap = cubemaps[layer];
+            unsigned int size = cubemap.size(job.level);
+            for (unsigned int y = job.y0; y < job.y1; y++) {
+                float v = (y + 0.5f) / size;
+                for (unsigned int x = job.x0; x < job.x1; x++) {
+                    float u = (x + 0.5f) / size;
+                    cubemap.setTexel(job.face, job.level, x, y, texel(layer, CPUCubemap::direction(job.face, u, v), job.level));
+                }
+            }
+        });
+    }
+
+    glm::vec3 sampleBilinear(const glm::vec3* data, int width, int height, float u, float v) {
+        float fx = u * width - 0.5f;
+        float fy = v * height - 0.5f;
+        float x0f = std::floor(fx);
+        float y0f = std::floor(fy);
+        float tx = fx - x0f;
+        float ty = fy - y0f;
+
+        int x0 = std::clamp((int)x0f, 0, width - 1);
+        int y0 = std::clamp((int)y0f, 0, height - 1);
+        int x1 = std::clamp((int)x0f + 1, 0, width - 1);
+        int y1 = std::clamp((int)y0f + 1, 0, height - 1);
+
+        glm::vec3 top = glm::mix(data[y0 * width + x0], data[y0 * width + x1], tx);
+        glm::vec3 bottom = glm::mix(data[y1 * width + x0], data[y1 * width + x1], tx);
+        return glm::mix(top, bottom, ty);
+    }
+
+    // Longitude / latitude bounds of a cubemap texel in equirectangular texture
+    // coordinates, from its corners and edge midpoints: on the +Y and -Y faces the
+    // latitude peaks in the middle of the edges. Exact 1 / 2PI and 1 / PI scales are
+    // used so that the longitudes of neighbouring texels meet at the seam.
+    void texelFootprint(unsigned int face, unsigned int x, unsigned int y, unsigned int size,
+                        float& u0, float& u1, float& v0, float& v1) {
+        float u[8], v[8];
+        unsigned int count = 0;
+        for (unsigned int j = 0; j <= 2; j++) {
+            for (unsigned int i = 0; i <= 2; i++) {
+                if (i == 1 && j == 1)
+                    continue;
+                glm::vec3 dir = CPUCubemap::direction(face, (x + 0.5f * i) / size, (y + 0.5f * j) / size);
+                u[count] = std::atan2(dir.z, dir.x) / (2.0f * PI) + 0.5f;
+                v[count] = std::atan2(dir.y, std::sqrt(dir.x * dir.x + dir.z * dir.z)) / PI + 0.5f;
+                count++;
+            }
+        }
+
+        u0 = *std::min_element(u, u + count);
+        u1 = *std::max_element(u, u + count);
+        v0 = *std::min_element(v, v + count);
+        v1 = *std::max_element(v, v + count);
+
+        // The texel holding a pole covers every longitude up to it
+        bool pole = (face == 2 || face == 3) && 2 * x <= size && size <= 2 * (x + 1) && 2 * y <= size && size <= 2 * (y + 1);
+        if (pole) {
+            u0 = 0.0f;
+            u1 = 1.0f;
+            if (face == 2)
+                v1 = 1.0f;
+            else
+                v0 = 0.0f;
+        }
+        // Otherwise a footprint spanning more than half a turn crosses the seam at -X
+        else if (u1 - u0 > 0.5f) {
+            for (unsigned int i = 0; i < count; i++) {
+                if (u[i] < 0.5f)
+                    u[i] += 1.0f;
+            }
+            u0 = *std::min_element(u, u + count);
+            u1 = *std::max_element(u, u + count);
+        }
+    }
+
+    // Fills row y of a face of the first level with one bilinear tap per texel. The
+    // equirectangular coordinates of the whole row are computed with SIMD first, then fetched.
+    void bilinearRow(CPUCubemap& envCubemap, const EquirectProjection& projection, const float* data,
+                     int width, int height, unsigned int face, unsigned int y) {
+        const glm::vec3* texels = reinterpret_cast<const glm::vec3*>(data);
+        unsigned int size = envCubemap.size();
+        std::vector<float> u(size), v(size);
+        projection.projectRow(face, y, u.data(), v.data());
+
+        float* r = envCubemap.plane(face, 0, 0) + (size_t)y * envCubemap.pitch(0);
+        float* g = envCubemap.plane(face, 0, 1) + (size_t)y * envCubemap.pitch(0);
+        float* b = envCubemap.plane(face, 0, 2) + (size_t)y * envCubemap.pitch(0);
+        for (unsigned int x = 0; x < size; x++) {
+            glm::vec3 color = sampleBilinear(texels, width, height, u[x], v[x]);
+            r[x] = color.r;
+            g[x] = color.g;
+            b[x] = color.b;
+        }
+    }
+
+    // Fills row y of a face of the first level with the average of the footprint of every texel
+    void areaFilterRow(CPUCubemap& envCubemap, const EquirectSAT& sat, unsigned int face, unsigned int y) {
+        unsigned int size = envCubemap.size();
+        for (unsigned int x = 0; x < size; x++) {
+            float u0, u1, v0, v1;
+            texelFootprint(face, x, y, size, u0, u1, v0, v1);
+            envCubemap.setTexel(face, 0, x, y, sat.average(u0, u1, v0, v1));
+        }
+    }
+
+    // Stores a map into an RGB16F gli cubemap of the result
+    void emitCubemap(const CPUCubemap& cubemap, gli::texture_cube& target, size_t levels) {
+        target = gli::texture_cube(gli::FORMAT_RGB16_SFLOAT_PACK16, gli::extent2d(cubemap.size(), cubemap.size()), levels);
+        cubemap.store(target);
+    }
+}
+
+CPUCubemap::CPUCubemap(unsigned int size, unsigned int levels)
+    : _size(size), _levels(levels), _faces(6 * levels) {
+
+    for (unsigned int level = 0; level < _levels; level++) {
+        size_t planeSize = (size_t)pitch(level) * (this->size(level) + 2);
+        for (unsigned int face = 0; face < 6; face++)
+            _faces[level * 6 + face].resize(3 * planeSize);
+    }
+}
+
+unsigned int CPUCubemap::size(unsigned int level) const {
+    return std::max(1u, _size >> level);
+}
+
+unsigned int CPUCubemap::levels() const {
+    return _levels;
+}
+
+unsigned int CPUCubemap::pitch(unsigned int level) const {
+    // Two border texels, rounded up to 4 floats
+    return (size(level) + 2 + 3) & ~3u;
+}
+
+float* CPUCubemap::plane(unsigned int face, unsigned int level, unsigned int channel) {
+    unsigned int rowPitch = pitch(level);
+    return _faces[level * 6 + face].data() + (size_t)channel * rowPitch * (size(level) + 2) + rowPitch + 1;
+}
+
+const float* CPUCubemap::plane(unsigned int face, unsigned int level, unsigned int channel) const {
+    unsigned int rowPitch = pitch(level);
+    return _faces[level * 6 + face].data() + (size_t)channel * rowPitch * (size(level) + 2) + rowPitch + 1;
+}
+
+glm::vec3 CPUCubemap::texel(unsigned int face, unsigned int level, int x, int y) const {
+    ptrdiff_t i = x + (ptrdiff_t)y * pitch(level);
+    return glm::vec3(plane(face, level, 0)[i], plane(face, level, 1)[i], plane(face, level, 2)[i]);
+}
+
+void CPUCubemap::setTexel(unsigned int face, unsigned int level, int x, int y, const glm::vec3& color) {
+    ptrdiff_t i = x + (ptrdiff_t)y * pitch(level);
+    plane(face, level, 0)[i] = color.r;
+    plane(face, level, 1)[i] = color.g;
+    plane(face, level, 2)[i] = color.b;
+}
+
+void CPUCubemap::readFace(unsigned int face, unsigned int level, float* rgb) const {
+    unsigned int levelSize = size(level);
+    unsigned int rowPitch = pitch(level);
+    const float* r = plane(face, level, 0);
+    const float* g = plane(face, level, 1);
+    const float* b = plane(face, level, 2);
+    for (unsigned int y = 0; y < levelSize; y++) {
+        size_t row = (size_t)y * rowPitch;
+        for (unsigned int x = 0; x < levelSize; x++) {
+            *rgb++ = r[row + x];
+            *rgb++ = g[row + x];
+            *rgb++ = b[row + x];
+        }
+    }
+}
+
+glm::vec3 CPUCubemap::direction(unsigned int face, float u, float v) {
+    float sc = 2.0f * u - 1.0f;
+    float tc = 2.0f * v - 1.0f;
+    switch (face) {
+    case 0: return glm::vec3(1.0f, -tc, -sc);
+    case 1: return glm::vec3(-1.0f, -tc, sc);
+    case 2: return glm::vec3(sc, 1.0f, tc);
+    case 3: return glm::vec3(sc, -1.0f, -tc);
+    case 4: return glm::vec3(sc, -tc, 1.0f);
+    default: return glm::vec3(-sc, -tc, -1.0f);
+    }
+}
+
+unsigned int CPUCubemap::faceCoords(const glm::vec3& dir, float& u, float& v) {
+    // Major axis selection, see table 8.19 of the OpenGL 4.6 specification
+    glm::vec3 a = glm::abs(dir);
+    unsigned int face;
+    float sc, tc, ma;
+    if (a.x >= a.y && a.x >= a.z) {
+        face = dir.x >= 0.0f ? 0 : 1;
+        sc = dir.x >= 0.0f ? -dir.z : dir.z;
+        tc = -dir.y;
+        ma = a.x;
+    }
+    else if (a.y >= a.z) {
+        face = dir.y >= 0.0f ? 2 : 3;
+        sc = dir.x;
+        tc = dir.y >= 0.0f ? dir.z : -dir.z;
+        ma = a.y;
+    }
+    else {
+        face = dir.z >= 0.0f ? 4 : 5;
+        sc = dir.z >= 0.0f ? dir.x : -dir.x;
+        tc = -dir.y;
+        ma = a.z;
+    }
+    float invMa = 0.5f / ma;
+    u = sc * invMa + 0.5f;
+    v = tc * invMa + 0.5f;
+    return face;
+}
+
+glm::vec3 CPUCubemap::sample(const glm::vec3& dir, float lod) const {
+    float u, v;
+    unsigned int face = faceCoords(dir, u, v);
+
+    lod = std::clamp(lod, 0.0f, (float)(_levels - 1));
+    unsigned int level = (unsigned int)lod;
+    float t = lod - level;
+    glm::vec3 color = sampleLevel(face, level, u, v);
+    if (t > 0.0f && level + 1 < _levels)
+        color = glm::mix(color, sampleLevel(face, level + 1, u, v), t);
+    return color;
+}
+
+glm::vec3 CPUCubemap::sampleLevel(unsigned int face, unsigned int level, float u, float v) const {
+    // The border makes the footprint valid up to half a texel past the edges of the face
+    int levelSize = (int)size(level);
+    float fx = u * levelSize - 0.5f;
+    float fy = v * levelSize - 0.5f;
+    float x0f = std::floor(fx);
+    float y0f = std::floor(fy);
+    float tx = fx - x0f;
+    float ty = fy - y0f;
+    int x0 = std::clamp((int)x0f, -1, levelSize - 1);
+    int y0 = std::clamp((int)y0f, -1, levelSize - 1);
+
+    ptrdiff_t rowPitch = pitch(level);
+    ptrdiff_t planeSize = rowPitch * (levelSize + 2);
+    const float* p = plane(face, level, 0) + x0 + y0 * rowPitch;
+    glm::vec3 color;
+    for (unsigned int c = 0; c < 3; c++, p += planeSize) {
+        float top = p[0] + (p[1] - p[0]) * tx;
+        float bottom = p[rowPitch] + (p[rowPitch + 1] - p[rowPitch]) * tx;
+        color[c] = top + (bottom - top) * ty;
+    }
+    return color;
+}
+
+void CPUCubemap::updateBorders(unsigned int level) {
+    int levelSize = (int)size(level);
+    // Texel of the face across the edge: a point just outside the edge, at the center of
+    // the border texel along it, lands in the neighbour's edge texel of the same row or column
+    auto neighbour = [&](unsigned int face, float u, float v) {
+        float nu, nv;
+        unsigned int nface = faceCoords(direction(face, u, v), nu, nv);
+        int x = std::clamp((int)(nu * levelSize), 0, levelSize - 1);
+        int y = std::clamp((int)(nv * levelSize), 0, levelSize - 1);
+        return texel(nface, level, x, y);
+    };
+
+    const float outside = 1e-4f;
+    for (unsigned int face = 0; face < 6; face++) {
+        for (int i = 0; i < levelSize; i++) {
+            float center = (i + 0.5f) / levelSize;
+            setTexel(face, level, -1, i, neighbour(face, -outside, center));
+            setTexel(face, level, levelSize, i, neighbour(face, 1.0f + outside, center));
+            setTexel(face, level, i, -1, neighbour(face, center, -outside));
+            setTexel(face, level, i, levelSize, neighbour(face, center, 1.0f + outside));
+        }
+
+        // Three faces meet at a corner, GL averages their texels
+        int last = levelSize - 1;
+        for (int cy : { -1, levelSize }) {
+            int y = cy < 0 ? 0 : last;
+            for (int cx : { -1, levelSize }) {
+                int x = cx < 0 ? 0 : last;
+                glm::vec3 corner = texel(face, level, x, y) + texel(face, level, cx, y) + texel(face, level, x, cy);
+                setTexel(face, level, cx, cy, corner / 3.0f);
+            }
+        }
+    }
+}
+
+void CPUCubemap::generateMipmaps() {
+    updateBorders(0);
+    for (unsigned int level = 1; level < _levels; level++) {
+        Utils::parallelFor(6 * 3, [&](unsigned int job) {
+            unsigned int face = job / 3;
+            unsigned int channel = job % 3;
+            unsigned int srcSize = size(level - 1);
+            unsigned int dstSize = size(level);
+            size_t srcPitch = pitch(level - 1);
+            size_t dstPitch = pitch(level);
+            const float* src = plane(face, level - 1, channel);
+            float* dst = plane(face, level, channel);
+            for (unsigned int y = 0; y < dstSize; y++) {
+                const float* row0 = src + std::min(2 * y, srcSize - 1) * srcPitch;
+                const float* row1 = src + std::min(2 * y + 1, srcSize - 1) * srcPitch;
+                for (unsigned int x = 0; x < dstSize; x++) {
+                    unsigned int x0 = std::min(2 * x, srcSize - 1);
+                    unsigned int x1 = std::min(2 * x + 1, srcSize - 1);
+                    dst[y * dstPitch + x] = 0.25f * (row0[x0] + row0[x1] + row1[x0] + row1[x1]);
+                }
+            }
+        });
+        updateBorders(level);
+    }
+}
+
+void CPUCubemap::store(gli::texture_cube& cubemap) const {
+    unsigned int levels = std::min(_levels, (unsigned int)cubemap.levels());
+    std::vector<float> rgb;
+    for (unsigned int level = 0; level < levels; level++) {
+        rgb.resize(3 * (size_t)size(level) * size(level));
+        for (unsigned int face = 0; face < 6; face++) {
+            readFace(face, level, rgb.data());
+            Half::storeFace(cubemap, face, level, rgb.data());
+        }
+    }
+}
+
+void CPUCubemap::load(const gli::texture_cube& cubemap) {
+    GLI_ASSERT(cubemap.format() == gli::FORMAT_RGB16_SFLOAT_PACK16 && cubemap.extent().x == (int)_size);
+
+    // Deinterleaves straight from the gli storage
+    size_t rowPitch = pitch(0);
+    for (unsigned int face = 0; face < 6; face++) {
+        const glm::uint16* src = cubemap.data<glm::uint16>(0, face, 0);
+        for (unsigned int c = 0; c < 3; c++) {
+            float* dst = plane(face, 0, c);
+            for (unsigned int y = 0; y < _size; y++) {
+                const glm::uint16* row = src + 3 * (size_t)y * _size + c;
+                for (unsigned int x = 0; x < _size; x++)
+                    dst[y * rowPitch + x] = glm::unpackHalf1x16(row[3 * x]);
+            }
+        }
+    }
+}
+
+CPUBaker::CPUBaker(const BakeOptions& options)
+    : _options(options), _projection(options.envRes) {
+
+}
+
+BakeResult CPUBaker::bake(const HDRImage& image, const BakeSink& sink) const {
+    return std::move(bake(std::vector<const HDRImage*>{ &image }, sink)[0]);
+}
+
+std::vector<BakeResult> CPUBaker::bake(const std::vector<const HDRImage*>& images, const BakeSink& sink) const {
+    std::vector<BakeResult> results(images.size());
+
+    std::vector<CPUCubemap> envCubemaps = equirectangularToCubemaps(images);
+    std::vector<const CPUCubemap*> envs;
+    for (size_t layer = 0; layer < images.size(); layer++) {
+        emitCubemap(envCubemaps[layer], results[layer].envMap, gli::levels(gli::extent2d(_options.envRes, _options.envRes)));
+        emitMap(sink, layer, BakeMap::Environment, results[layer].envMap);
+        envs.push_back(&envCubemaps[layer]);
+    }
+
+    bakeMaps(envs, results, sink);
+    return results;
+}
+
+BakeResult CPUBaker::bake(const gli::texture_cube& envMap, const BakeSink& sink) const {
+    GLI_ASSERT(envMap.format() == gli::FORMAT_RGB16_SFLOAT_PACK16 && envMap.extent().x == (int)_options.envRes);
+    std::vector<BakeResult> results(1);
+
+    CPUCubemap envCubemap(_options.envRes, gli::levels(gli::extent2d(_options.envRes, _options.envRes)));
+    envCubemap.load(envMap);
+    envCubemap.generateMipmaps();
+
+    bakeMaps({ &envCubemap }, results, sink);
+    return std::move(results[0]);
+}
+
+void CPUBaker::bakeMaps(const std::vector<const CPUCubemap*>& envCubemaps, std::vector<BakeResult>& results, const BakeSink& sink) const {
+    std::vector<std::unique_ptr<LightSampler>> lightSamplers;
+    std::vector<const LightSampler*> lights;
+    if (_options.lightSamples != 0) {
+        unsigned int level = LightSampler::level(_options.envRes);
+        for (const CPUCubemap* envCubemap : envCubemaps) {
+            unsigned int size = envCubemap->size(level);
+            std::vector<float> rgb(6 * 3 * (size_t)size * size);
+            for (unsigned int face = 0; face < 6; face++)
+                envCubemap->readFace(face, level, rgb.data() + face * 3 * (size_t)size * size);
+            lightSamplers.emplace_back(new LightSampler(rgb.data(), size));
+            lights.push_back(lightSamplers.back().get());
+        }
+    }
+
+    size_t irradianceLevels = gli::levels(gli::extent2d(_options.irradianceRes, _options.irradianceRes));
+    if (_options.irradiance == IrradianceMode::Convolution) {
+        std::vector<CPUCubemap> irradianceMaps = irradiance(envCubemaps, lights);
+        for (size_t layer = 0; layer < envCubemaps.size(); layer++) {
+            emitCubemap(irradianceMaps[layer], results[layer].irradianceMap, irradianceLevels);
+            emitMap(sink, layer, BakeMap::Irradiance, results[layer].irradianceMap);
+        }
+    }
+    else {
+        std::vector<SphericalHarmonics> irradianceSH;
+        std::vector<float> rgb(3 * (size_t)_options.envRes * _options.envRes);
+        for (size_t layer = 0; layer < envCubemaps.size(); layer++) {
+            SphericalHarmonics radianceSH;
+            for (unsigned int face = 0; face < 6; face++) {
+                envCubemaps[layer]->readFace(face, 0, rgb.data());
+                radianceSH.addFace(face, rgb.data(), _options.envRes);
+            }
+            results[layer].irradianceSH = radianceSH.irradiance();
+            irradianceSH.push_back(results[layer].irradianceSH);
+        }
+
+        if (_options.irradiance == IrradianceMode::SH) {
+            std::vector<CPUCubemap> irradianceMaps = irradiance(irradianceSH);
+            for (size_t layer = 0; layer < envCubemaps.size(); layer++) {
+                emitCubemap(irradianceMaps[layer], results[layer].irradianceMap, irradianceLevels);
+                emitMap(sink, layer, BakeMap::Irradiance, results[layer].irradianceMap);
+            }
+        }
+    }
+
+    std::vector<CPUCubemap> prefilterMaps = prefilter(envCubemaps, lights);
+    for (size_t layer = 0; layer < envCubemaps.size(); layer++) {
+        emitCubemap(prefilterMaps[layer], results[layer].prefilterMap, _options.prefilterLevels);
+        emitMap(sink, layer, BakeMap::Prefilter, results[layer].prefilterMap);
+    }
+}
+
+CPUCubemap CPUBaker::equirectangularToCubemap(const float* data, int width, int height) const {
+    CPUCubemap envCubemap(_options.envRes, gli::levels(gli::extent2d(_options.envRes, _options.envRes)));
+    unsigned int size = _options.envRes;
+
+    if (_options.areaFilter) {
+        EquirectSAT sat(data, width, height, AREA_FILTER_WIDTH_RATIO * size);
+        Utils::parallelFor(6 * size, [&](unsigned int job) {
+            areaFilterRow(envCubemap, sat, job / size, job % size);
+        });
+    }
+    else {
+        Utils::parallelFor(6 * size, [&](unsigned int job) {
+            bilinearRow(envCubemap, _projection, data, width, height, job / size, job % size);
+        });
+    }
+
+    envCubemap.generateMipmaps();
+    return envCubemap;
+}
+
+std::vector<CPUCubemap> CPUBaker::equirectangularToCubemaps(const std::vector<const HDRImage*>& images) const {
+    // Summed-area tables are large, the area filter builds and uses them one image at a time
+    if (_options.areaFilter) {
+        std::vector<CPUCubemap> envCubemaps;
+        for (const HDRImage* image : images)
+            envCubemaps.push_back(equirectangularToCubemap(image->data(), image->width(), image->height()));
+        return envCubemaps;
+    }
+
+    unsigned int size = _options.envRes;
+    std::vector<CPUCubemap> envCubemaps(images.size(), CPUCubemap(size, gli::levels(gli::extent2d(size, size))));
+
+    Utils::parallelFor((unsigned int)images.size() * 6 * size, [&](unsigned int job) {
+        const HDRImage* image = images[job / (6 * size)];
+        bilinearRow(envCubemaps[job / (6 * size)], _projection, image->data(), image->width(), image->height(),
+                    job / size % 6, job % size);
+    });
+
+    for (CPUCubemap& envCubemap : envCubemaps)
+        envCubemap.generateMipmaps();
+    return envCubemaps;
+}
+
+CPUCubemap CPUBaker::irradiance(const CPUCubemap& envCubemap, const LightSampler* lights) const {
+    std::vector<const LightSampler*> layerLights;
+    if (lights)
+        layerLights.push_back(lights);
+    return std::move(irradiance(std::vector<const CPUCubemap*>{ &envCubemap }, layerLights)[0]);
+}
+
+std::vector<CPUCubemap> CPUBaker::irradiance(const std::vector<const CPUCubemap*>& envCubemaps, const std::vector<const LightSampler*>& lights) const {
+    std::vector<CPUCubemap> irradianceMaps(envCubemaps.size(), CPUCubemap(_options.irradianceRes));
+
+    if (!lights.empty()) {
+        // Mirrors shaders/irradiance_mis.fs: cosine weighted samples and light samples,
+        // weighted by the balance heuristic. Each one adds L * (NdotL / PI) divided by
+        // the sum of count * pdf of both strategies.
+        std::vector<glm::vec4> cosineSamples = LightSampler::cosineSamples(_options.lightSamples);
+        std::vector<std::vector<glm::vec4>> lightSamples;
+        for (const LightSampler* layerLights : lights)
+            lightSamples.push_back(layerLights->samples(_options.lightSamples));
+        float cosineCount = (float)cosineSamples.size();
+
+        bakeTexels(irradianceMaps, 1, [&](unsigned int layer, const glm::vec3& dir, unsigned int) {
+            glm::vec3 N = glm::normalize(dir);
+            glm::vec3 up = std::abs(N.z) < 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+            glm::vec3 right = glm::normalize(glm::cross(up, N));
+            up = glm::cross(N, right);
+
+            const LightSampler* layerLights = lights[layer];
+            float lightCount = (float)lightSamples[layer].size();
+            glm::vec3 irradiance = glm::vec3(0.0f);
+            for (const glm::vec4& s : cosineSamples) {
+                glm::vec4 light = layerLights->evaluate(s.x * right + s.y * up + s.z * N);
+                irradiance += glm::vec3(light) * (s.z / PI / (cosineCount * s.w + lightCount * light.w));
+            }
+            for (const glm::vec4& s : lightSamples[layer]) {
+                float NdotL = glm::dot(N, glm::vec3(s));
+                if (NdotL > 0.0f) {
+                    glm::vec3 radiance = glm::vec3(layerLights->evaluate(glm::vec3(s)));
+                    irradiance += radiance * (NdotL / PI / (cosineCount * NdotL / PI + lightCount * s.w));
+                }
+            }
+            return irradiance;
+        });
+
+        return irradianceMaps;
+    }
+
+    // The hemisphere samples only depend on the loop counters, build them once.
+    // xyz is the tangent space direction and w the cos(theta) * sin(theta) weight.
+    std::vector<glm::vec4> samples;
+    for (float phi = 0.0f; phi < 2.0f * PI; phi += IRRADIANCE_SAMPLE_DELTA) {
+        for (float theta = 0.0f; theta < 0.5f * PI; theta += IRRADIANCE_SAMPLE_DELTA) {
+            samples.push_back(glm::vec4(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta),
+                                        std::cos(theta) * std::sin(theta)));
+        }
+    }
+
+    // texture() in irradiance.fs picks its LOD from screen space derivatives, which
+    // step one output texel at a time: that is the env level matching the output size
+    float lod = std::log2((float)_options.envRes / (float)_options.irradianceRes);
+
+    bakeTexels(irradianceMaps, 1, [&](unsigned int layer, const glm::vec3& dir, unsigned int) {
+        glm::vec3 N = glm::normalize(dir);
+        glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f);
+        glm::vec3 right = glm::cross(up, N);
+        up = glm::cross(N, right);
+
+        glm::vec3 irradiance = glm::vec3(0.0f);
+        for (const glm::vec4& s : samples) {
+            glm::vec3 sampleVec = s.x * right + s.y * up + s.z * N;
+            irradiance += envCubemaps[layer]->sample(sampleVec, lod) * s.w;
+        }
+        return PI * irradiance * (1.0f / (float)samples.size());
+    });
+
+    return irradianceMaps;
+}
+
+CPUCubemap CPUBaker::irradiance(const SphericalHarmonics& irradianceSH) const {
+    return std::move(irradiance(std::vector<SphericalHarmonics>{ irradianceSH })[0]);
+}
+
+std::vector<CPUCubemap> CPUBaker::irradiance(const std::vector<SphericalHarmonics>& irradianceSH) const {
+    std::vector<CPUCubemap> irradianceMaps(irradianceSH.size(), CPUCubemap(_options.irradianceRes));
+
+    bakeTexels(irradianceMaps, 1, [&](unsigned int layer, const glm::vec3& dir, unsigned int) {
+        return irradianceSH[layer].evaluate(glm::normalize(dir));
+    });
+
+    return irradianceMaps;
+}
+
+CPUCubemap CPUBaker::prefilter(const CPUCubemap& envCubemap, const LightSampler* lights) const {
+    std::vector<const LightSampler*> layerLights;
+    if (lights)
+        layerLights.push_back(lights);
+    return std::move(prefilter(std::vector<const CPUCubemap*>{ &envCubemap }, layerLights)[0]);
+}
+
+std::vector<CPUCubemap> CPUBaker::prefilter(const std::vector<const CPUCubemap*>& envCubemaps, const std::vector<const LightSampler*>& lights) const {
+    std::vector<CPUCubemap> prefilterMaps(envCubemaps.size(), CPUCubemap(_options.prefilterRes, _options.prefilterLevels));
+
+    // One table of tangent space samples per level, see GGXSamples
+    std::vector<std::vector<glm::vec4>> samples(_options.prefilterLevels);
+    for (unsigned int level = 0; level < _options.prefilterLevels; level++)
+        samples[level] = GGXSamples::level(_options, level);
+
+    std::vector<std::vector<glm::vec4>> lightSamples;
+    for (const LightSampler* layerLights : lights)
+        lightSamples.push_back(layerLights->samples(_options.lightSamples));
+
+    bakeTexels(prefilterMaps, _options.prefilterLevels, [&](unsigned int layer, const glm::vec3& dir, unsigned int level) {
+        glm::vec3 N = glm::normalize(dir);
+        glm::vec3 up = std::abs(N.z) < 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+        glm::vec3 tangent = glm::normalize(glm::cross(up, N));
+        glm::vec3 bitangent = glm::cross(N, tangent);
+
+        // Mirrors the light sampling branch of shaders/prefilter.fs. With V = N the GGX pdf
+        // of L is D / 4, each sample is weighted by D * NdotL divided by the sum of count * pdf
+        // of both strategies. The first level is a plain downsample and keeps its single sample.
+        if (!lights.empty() && level > 0) {
+            const LightSampler* layerLights = lights[layer];
+            float roughness = (float)level / (float)(_options.prefilterLevels - 1);
+            float a2 = roughness * roughness * roughness * roughness;
+            float ggxCount = (float)GGXSamples::count(_options, level);
+            float lightCount = (float)lightSamples[layer].size();
+
+            glm::vec3 prefilteredColor = glm::vec3(0.0f);
+            float totalWeight = 0.0f;
+            auto accumulate = [&](const glm::vec3& radiance, float NdotL, float lightPdf) {
+                // NdotH^2 from the half angle between N and L
+                float denom = 0.5f * (1.0f + NdotL) * (a2 - 1.0f) + 1.0f;
+                float D = a2 / (PI * denom * denom);
+                float weight = D * NdotL / (ggxCount * 0.25f * D + lightCount * lightPdf);
+                prefilteredColor += radiance * weight;
+                totalWeight += weight;
+            };
+
+            for (const glm::vec4& s : samples[level]) {
+                glm::vec4 light = layerLights->evaluate(tangent * s.x + bitangent * s.y + N * s.z);
+                accumulate(glm::vec3(light), s.z, light.w);
+            }
+            for (const glm::vec4& s : lightSamples[layer]) {
+                float NdotL = glm::dot(N, glm::vec3(s));
+                if (NdotL > 0.0f)
+                    accumulate(glm::vec3(layerLights->evaluate(glm::vec3(s))), NdotL, s.w);
+            }
+            return prefilteredColor / totalWeight;
+        }
+
+        glm::vec3 prefilteredColor = glm::vec3(0.0f);
+        float totalWeight = 0.0f;
+        for (const glm::vec4& s : samples[level]) {
+            glm::vec3 L = tangent * s.x + bitangent * s.y + N * s.z;
+            prefilteredColor += envCubemaps[layer]->sample(L, s.w) * s.z;
+            totalWeight += s.z;
+        }
+        return prefilteredColor / totalWeight;
+    });
+
+    return prefilterMaps;
+}
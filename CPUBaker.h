@@ -0,0 +1,108 @@
+#ifndef __XGP_CPUBAKER_H__
+#define __XGP_CPUBAKER_H__
+
+#include <glm/glm.hpp>
+#include <gli/gli.hpp>
+
+#include <vector>
+
+#include <Bake.h>
+#include <EquirectProjection.h>
+
+class HDRImage;
+class LightSampler;
+
+// Float RGB cubemap with a mip chain, sampled the way GL samples a
+// GL_CLAMP_TO_EDGE / GL_LINEAR_MIPMAP_LINEAR cubemap with GL_TEXTURE_CUBE_MAP_SEAMLESS.
+// Every face of every level is stored as three planes (R, G, B) with rows padded to
+// 16 bytes and a one texel border holding the texels of the neighbouring faces, so
+// bilinear filtering reads across edges without any face lookup.
+class CPUCubemap {
+public:
+	CPUCubemap(unsigned int size, unsigned int levels = 1);
+
+	unsigned int size(unsigned int level = 0) const;
+	unsigned int levels() const;
+	// Floats from one row of a plane to the next
+	unsigned int pitch(unsigned int level) const;
+
+	// Texel (0, 0) of a channel plane, texel (x, y) is at x + y * pitch(level).
+	// The border lies at x or y = -1 and size(level).
+	float* plane(unsigned int face, unsigned int level, unsigned int channel);
+	const float* plane(unsigned int face, unsigned int level, unsigned int channel) const;
+
+	glm::vec3 texel(unsigned int face, unsigned int level, int x, int y) const;
+	void setTexel(unsigned int face, unsigned int level, int x, int y, const glm::vec3& color);
+
+	// Copies a face into tightly packed interleaved RGB floats, the layout of gli and DDS files
+	void readFace(unsigned int face, unsigned int level, float* rgb) const;
+
+	// Trilinear and seamless, needs up to date borders, see generateMipmaps()
+	glm::vec3 sample(const glm::vec3& dir, float lod) const;
+
+	// Box-filters every level from the one above it, like glGenerateMipmap, and
+	// fills the borders of all levels. Call it once the first level is written.
+	void generateMipmaps();
+
+	// Writes every level both cubemaps have in common into an RGB16F gli cubemap
+	void store(gli::texture_cube& cubemap) const;
+	// Reads the first level of an RGB16F gli cubemap of the same size, see generateMipmaps() for the others
+	void load(const gli::texture_cube& cubemap);
+
+	// Direction through the center of texel (u, v) of a face, u and v in [0, 1],
+	// matching the capture views used by the OpenGL path
+	static glm::vec3 direction(unsigned int face, float u, float v);
+	// Inverse of direction(): the face dir points to and its (u, v) in [0, 1]
+	static unsigned int faceCoords(const glm::vec3& dir, float& u, float& v);
+
+private:
+	glm::vec3 sampleLevel(unsigned int face, unsigned int level, float u, float v) const;
+	// Copies the edge texels of the faces around each face into its border
+	void updateBorders(unsigned int level);
+
+	unsigned int _size;
+	unsigned int _levels;
+	std::vector<std::vector<float>> _faces; // indexed by level * 6 + face, 3 planes of (size + 2) rows each
+};
+
+// Pure CPU implementation of the equirectangular, irradiance and prefilter
+// passes, spreading (layer, mip, face, tile) jobs over all hardware threads
+class CPUBaker {
+public:
+	CPUBaker(const BakeOptions& options);
+
+	// Runs every pass requested by the options, producing the same maps as Baker::bake().
+	// Each map goes to sink, when given, as soon as its pass is done.
+	BakeResult bake(const HDRImage& image, const BakeSink& sink = BakeSink()) const;
+	// Bakes from an environment map baked earlier with the same options, see Baker::bake().
+	// The maps match a full bake up to the half float rounding of the environment.
+	BakeResult bake(const gli::texture_cube& envMap, const BakeSink& sink = BakeSink()) const;
+	// Bakes the images as the layers of one batch: every pass runs the texels of all
+	// of them in a single parallelFor instead of one per image
+	std::vector<BakeResult> bake(const std::vector<const HDRImage*>& images, const BakeSink& sink = BakeSink()) const;
+
+	// data is bottom-up RGB float, as loaded with stbi_set_flip_vertically_on_load(true)
+	CPUCubemap equirectangularToCubemap(const float* data, int width, int height) const;
+	std::vector<CPUCubemap> equirectangularToCubemaps(const std::vector<const HDRImage*>& images) const;
+	// Both passes combine their BRDF samples with BakeOptions::lightSamples samples of lights when given one
+	CPUCubemap irradiance(const CPUCubemap& envCubemap, const LightSampler* lights = nullptr) const;
+	// Evaluates already convolved irradiance coefficients, see SphericalHarmonics::irradiance()
+	CPUCubemap irradiance(const SphericalHarmonics& irradianceSH) const;
+	CPUCubemap prefilter(const CPUCubemap& envCubemap, const LightSampler* lights = nullptr) const;
+
+	// Layered versions of the passes, lights is either empty or holds the lights of every layer
+	std::vector<CPUCubemap> irradiance(const std::vector<const CPUCubemap*>& envCubemaps,
+		const std::vector<const LightSampler*>& lights) const;
+	std::vector<CPUCubemap> irradiance(const std::vector<SphericalHarmonics>& irradianceSH) const;
+	std::vector<CPUCubemap> prefilter(const std::vector<const CPUCubemap*>& envCubemaps,
+		const std::vector<const LightSampler*>& lights) const;
+
+private:
+	// Irradiance and prefilter passes
+	void bakeMaps(const std::vector<const CPUCubemap*>& envCubemaps, std::vector<BakeResult>& results, const BakeSink& sink) const;
+
+	BakeOptions _options;
+	EquirectProjection _projection;
+};
+
+#endif
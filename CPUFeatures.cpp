@@ -0,0 +1,85 @@
+#include "CPUFeatures.h"
+
+#ifdef CPU_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace {
+#ifdef CPU_X86
+    // ECX of leaf 1 and EBX of leaf 7
+    void cpuid(unsigned int& ecx1, unsigned int& ebx7) {
+        ecx1 = ebx7 = 0;
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        int maxLeaf = info[0];
+        __cpuid(info, 1);
+        ecx1 = (unsigned int)info[2];
+        if (maxLeaf >= 7) {
+            __cpuidex(info, 7, 0);
+            ebx7 = (unsigned int)info[1];
+        }
+#else
+        unsigned int eax, ebx, ecx, edx;
+        if (__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+            ecx1 = ecx;
+        if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+            ebx7 = ebx;
+#endif
+    }
+
+    // OSXSAVE and AVX, and the OS saves the YMM registers
+    bool hasAVX(unsigned int ecx1) {
+        bool osxsave = (ecx1 & (1u << 27)) != 0;
+        bool avx = (ecx1 & (1u << 28)) != 0;
+        if (!osxsave || !avx)
+            return false;
+
+#if defined(_MSC_VER)
+        unsigned long long xcr0 = _xgetbv(0);
+#else
+        unsigned int lo, hi;
+        __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        unsigned long long xcr0 = ((unsigned long long)hi << 32) | lo;
+#endif
+        return (xcr0 & 6) == 6;
+    }
+
+    struct Features {
+        bool f16c = false;
+        bool avx2 = false;
+
+        Features() {
+            unsigned int ecx1, ebx7;
+            cpuid(ecx1, ebx7);
+            if (!hasAVX(ecx1))
+                return;
+            f16c = (ecx1 & (1u << 29)) != 0;
+            avx2 = (ecx1 & (1u << 12)) != 0 && (ebx7 & (1u << 5)) != 0;
+        }
+    };
+#else
+    struct Features {
+        bool f16c = false;
+        bool avx2 = false;
+    };
+#endif
+
+    // Detected once, on first use
+    const Features& features() {
+        static const Features detected;
+        return detected;
+    }
+}
+
+bool CPUFeatures::hasF16C() {
+    return features().f16c;
+}
+
+bool CPUFeatures::hasAVX2() {
+    return features().avx2;
+}
@@ -0,0 +1,25 @@
+#ifndef __XGP_CPUFEATURES_H__
+#define __XGP_CPUFEATURES_H__
+
+// SIMD support shared by the CPU code paths. CPU_X86 is defined when compiling for x86,
+// where SSE2 is always there and the wider instruction sets are detected at run time.
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CPU_X86
+#include <immintrin.h>
+#endif
+
+// MSVC lets any function use any intrinsic, GCC and Clang need them enabled per function
+#if defined(__GNUC__) || defined(__clang__)
+#define CPU_TARGET(x) __attribute__((target(x)))
+#else
+#define CPU_TARGET(x)
+#endif
+
+namespace CPUFeatures {
+	// AVX and F16C, with the YMM registers saved by the OS. Always false off x86.
+	bool hasF16C();
+	// AVX2 and FMA, with the same OS support
+	bool hasAVX2();
+}
+
+#endif
@@ -0,0 +1,135 @@
+#include "DDSWriter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace {
+    size_t levelSize(gli::format format, unsigned int size, unsigned int level) {
+        glm::ivec3 blockExtent = gli::block_extent(format);
+        size_t levelRes = std::max(1u, size >> level);
+        size_t blocksX = (levelRes + blockExtent.x - 1) / blockExtent.x;
+        size_t blocksY = (levelRes + blockExtent.y - 1) / blockExtent.y;
+        return blocksX * blocksY * gli::block_size(format);
+    }
+
+    // Same header gli::save_dds() writes for a cubemap or a cubemap array, see gli/core/save_dds.inl
+    std::vector<char> cubemapHeader(gli::format format, unsigned int size, unsigned int levels, size_t faceSize, unsigned int layers) {
+        gli::dx DX;
+        const gli::dx::format& DXFormat = DX.translate(format);
+        bool requireDX10Header = DXFormat.D3DFormat == gli::dx::D3DFMT_GLI1 || DXFormat.D3DFormat == gli::dx::D3DFMT_DX10 || layers > 1;
+
+        std::vector<char> memory(sizeof(gli::detail::FOURCC_DDS) + sizeof(gli::detail::dds_header) + (requireDX10Header ? sizeof(gli::detail::dds_header10) : 0), 0);
+        std::memcpy(&memory[0], gli::detail::FOURCC_DDS, sizeof(gli::detail::FOURCC_DDS));
+        size_t offset = sizeof(gli::detail::FOURCC_DDS);
+
+        gli::detail::dds_header& header = *reinterpret_cast<gli::detail::dds_header*>(&memory[offset]);
+        offset += sizeof(gli::detail::dds_header);
+
+        bool compressed = gli::is_compressed(format);
+        header.Size = sizeof(gli::detail::dds_header);
+        header.Flags = gli::detail::DDSD_CAPS | gli::detail::DDSD_WIDTH | gli::detail::DDSD_PIXELFORMAT | gli::detail::DDSD_MIPMAPCOUNT | gli::detail::DDSD_HEIGHT;
+        header.Flags |= compressed ? gli::detail::DDSD_LINEARSIZE : gli::detail::DDSD_PITCH;
+        header.Width = size;
+        header.Height = size;
+        header.Pitch = compressed ? (std::uint32_t)faceSize : 32;
+        header.Depth = 0;
+        header.MipMapLevels = levels;
+        header.Format.size = sizeof(gli::detail::dds_pixel_format);
+        header.Format.flags = requireDX10Header ? gli::dx::DDPF_FOURCC : DXFormat.DDPixelFormat;
+        header.Format.fourCC = gli::detail::get_fourcc(requireDX10Header, format, DXFormat);
+        header.Format.bpp = (std::uint32_t)gli::detail::bits_per_pixel(format);
+        header.Format.Mask = DXFormat.Mask;
+        header.SurfaceFlags = gli::detail::DDSCAPS_TEXTURE | gli::detail::DDSCAPS_MIPMAP;
+        header.CubemapFlags = gli::detail::DDSCAPS2_CUBEMAP_ALLFACES | gli::detail::DDSCAPS2_CUBEMAP;
+
+        if (requireDX10Header) {
+            gli::detail::dds_header10& header10 = *reinterpret_cast<gli::detail::dds_header10*>(&memory[offset]);
+            header10.ArraySize = layers;
+            header10.ResourceDimension = gli::detail::D3D10_RESOURCE_DIMENSION_TEXTURE2D;
+            header10.MiscFlag = gli::detail::D3D10_RESOURCE_MISC_TEXTURECUBE;
+            header10.Format = DXFormat.DXGIFormat;
+            header10.AlphaFlags = gli::detail::DDS_ALPHA_MODE_UNKNOWN;
+        }
+
+        return memory;
+    }
+}
+
+DDSWriter::DDSWriter()
+    : _format(gli::FORMAT_UNDEFINED), _size(0), _levels(0), _layers(0), _dataOffset(0), _faceSize(0) {
+
+}
+
+DDSWriter::~DDSWriter() {
+    if (isOpen())
+        close();
+}
+
+bool DDSWriter::open(const std::string& filepath, gli::format format, unsigned int size, unsigned int levels, unsigned int layers) {
+    if (isOpen())
+        close();
+
+    _filepath = filepath;
+    _format = format;
+    _size = size;
+    _levels = levels;
+    _layers = layers;
+    _faceSize = 0;
+    for (unsigned int level = 0; level < levels; level++)
+        _faceSize += levelSize(format, size, level);
+
+    _file.open(filepath, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    if (_file.fail())
+        return false;
+
+    std::vector<char> header = cubemapHeader(format, size, levels, _faceSize, layers);
+    _dataOffset = header.size();
+    _file.write(header.data(), header.size());
+
+    // Preallocate the file by writing its last byte, the faces are then written in place
+    if (_faceSize > 0) {
+        _file.seekp(_dataOffset + 6 * layers * _faceSize - 1);
+        _file.put('\0');
+    }
+    return !_file.fail();
+}
+
+bool DDSWriter::isOpen() const {
+    return _file.is_open();
+}
+
+size_t DDSWriter::size(unsigned int level) const {
+    return levelSize(_format, _size, level);
+}
+
+unsigned int DDSWriter::levels() const {
+    return _levels;
+}
+
+const std::string& DDSWriter::filepath() const {
+    return _filepath;
+}
+
+bool DDSWriter::write(unsigned int face, unsigned int level, const void* data, unsigned int layer) {
+    // Anything outside of the file would be written past its end or over another face
+    if (!isOpen() || face >= 6 || level >= _levels || layer >= _layers)
+        return false;
+
+    // Array layers follow each other, each laid out like a single cubemap
+    size_t offset = _dataOffset + (6 * (size_t)layer + face) * _faceSize;
+    for (unsigned int i = 0; i < level; i++)
+        offset += size(i);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _file.seekp(offset);
+    _file.write((const char*)data, size(level));
+    return !_file.fail();
+}
+
+bool DDSWriter::close() {
+    _file.close();
+    bool success = !_file.fail();
+    _file.clear();
+    return success;
+}
@@ -0,0 +1,51 @@
+#ifndef __XGP_DDSWRITER_H__
+#define __XGP_DDSWRITER_H__
+
+#include <gli/gli.hpp>
+
+#include <fstream>
+#include <mutex>
+#include <string>
+
+// Writes a cubemap DDS file without building it in memory first. The layout of a
+// cube with a known format and level count is fixed, so open() writes the header
+// and preallocates the whole file, then every face/level is written straight to its
+// offset whenever it is encoded, in any order and from any thread. The header and data
+// layout are the same as gli::save_dds() produces. Cubemap arrays are written the same
+// way, one layer of 6 faces after the other.
+class DDSWriter {
+public:
+	DDSWriter();
+	~DDSWriter();
+
+	DDSWriter(const DDSWriter&) = delete;
+	DDSWriter& operator=(const DDSWriter&) = delete;
+
+	bool open(const std::string& filepath, gli::format format, unsigned int size, unsigned int levels, unsigned int layers = 1);
+	bool isOpen() const;
+
+	// Size in bytes of one face of a level
+	size_t size(unsigned int level) const;
+	unsigned int levels() const;
+	const std::string& filepath() const;
+
+	// data holds size(level) bytes, laid out like gli stores the face. Returns false,
+	// without writing, for a face, level or layer the file doesn't have. Concurrent
+	// writes are serialized.
+	bool write(unsigned int face, unsigned int level, const void* data, unsigned int layer = 0);
+	// Flushes the file, returns false if any write failed
+	bool close();
+
+private:
+	std::ofstream _file;
+	std::mutex _mutex;
+	std::string _filepath;
+	gli::format _format;
+	unsigned int _size;
+	unsigned int _levels;
+	unsigned int _layers;
+	size_t _dataOffset;
+	size_t _faceSize;   // all levels of one face
+};
+
+#endif
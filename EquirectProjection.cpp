@@ -0,0 +1,171 @@
+#include "EquirectProjection.h"
+
+#include <CPUFeatures.h>
+
+#include <cmath>
+
+// Same constants as invAtan in equirectangular.fs, approximations of 1 / 2PI and 1 / PI
+#define INV_ATAN_U 0.1591f
+#define INV_ATAN_V 0.3183f
+
+static const float PI = 3.14159265359f;
+
+namespace {
+    // A face direction is S * sc + T * tc + C, the columns of CPUCubemap::direction()
+    struct FaceBasis {
+        float S[3], T[3], C[3];
+    };
+
+    const FaceBasis FACES[6] = {
+        { {  0.0f, 0.0f, -1.0f }, { 0.0f, -1.0f,  0.0f }, {  1.0f,  0.0f,  0.0f } },
+        { {  0.0f, 0.0f,  1.0f }, { 0.0f, -1.0f,  0.0f }, { -1.0f,  0.0f,  0.0f } },
+        { {  1.0f, 0.0f,  0.0f }, { 0.0f,  0.0f,  1.0f }, {  0.0f,  1.0f,  0.0f } },
+        { {  1.0f, 0.0f,  0.0f }, { 0.0f,  0.0f, -1.0f }, {  0.0f, -1.0f,  0.0f } },
+        { {  1.0f, 0.0f,  0.0f }, { 0.0f, -1.0f,  0.0f }, {  0.0f,  0.0f,  1.0f } },
+        { { -1.0f, 0.0f,  0.0f }, { 0.0f, -1.0f,  0.0f }, {  0.0f,  0.0f, -1.0f } },
+    };
+
+    // Minimax atan on [-1, 1]
+    const float ATAN_C0 = 0.99997726f;
+    const float ATAN_C1 = -0.33262347f;
+    const float ATAN_C2 = 0.19354346f;
+    const float ATAN_C3 = -0.11643287f;
+    const float ATAN_C4 = 0.05265332f;
+    const float ATAN_C5 = -0.01172120f;
+
+    float atan2Scalar(float y, float x) {
+        float ax = std::fabs(x);
+        float ay = std::fabs(y);
+        float a = std::fmin(ax, ay) / std::fmax(std::fmax(ax, ay), 1e-30f);
+        float s = a * a;
+        float r = a * (ATAN_C0 + s * (ATAN_C1 + s * (ATAN_C2 + s * (ATAN_C3 + s * (ATAN_C4 + s * ATAN_C5)))));
+        if (ay > ax)
+            r = 0.5f * PI - r;
+        if (x < 0.0f)
+            r = PI - r;
+        return y < 0.0f ? -r : r;
+    }
+
+    // Rows are projected from the face coordinates: u from atan2(z, x), and v from
+    // asin(y / |dir|) = atan2(y, length(dir.xz)), so the direction is never normalized
+    void projectScalar(const FaceBasis& f, const float* sc, float tc, unsigned int begin, unsigned int end, float* u, float* v) {
+        float kx = f.T[0] * tc + f.C[0];
+        float ky = f.T[1] * tc + f.C[1];
+        float kz = f.T[2] * tc + f.C[2];
+        for (unsigned int i = begin; i < end; i++) {
+            float x = f.S[0] * sc[i] + kx;
+            float y = f.S[1] * sc[i] + ky;
+            float z = f.S[2] * sc[i] + kz;
+            u[i] = atan2Scalar(z, x) * INV_ATAN_U + 0.5f;
+            v[i] = atan2Scalar(y, std::sqrt(x * x + z * z)) * INV_ATAN_V + 0.5f;
+        }
+    }
+
+#ifdef CPU_X86
+    CPU_TARGET("avx2,fma")
+    __m256 atan2AVX2(__m256 y, __m256 x) {
+        const __m256 signMask = _mm256_set1_ps(-0.0f);
+        __m256 ax = _mm256_andnot_ps(signMask, x);
+        __m256 ay = _mm256_andnot_ps(signMask, y);
+        __m256 a = _mm256_div_ps(_mm256_min_ps(ax, ay), _mm256_max_ps(_mm256_max_ps(ax, ay), _mm256_set1_ps(1e-30f)));
+        __m256 s = _mm256_mul_ps(a, a);
+        __m256 p = _mm256_fmadd_ps(s, _mm256_set1_ps(ATAN_C5), _mm256_set1_ps(ATAN_C4));
+        p = _mm256_fmadd_ps(s, p, _mm256_set1_ps(ATAN_C3));
+        p = _mm256_fmadd_ps(s, p, _mm256_set1_ps(ATAN_C2));
+        p = _mm256_fmadd_ps(s, p, _mm256_set1_ps(ATAN_C1));
+        p = _mm256_fmadd_ps(s, p, _mm256_set1_ps(ATAN_C0));
+        __m256 r = _mm256_mul_ps(a, p);
+
+        r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(0.5f * PI), r), _mm256_cmp_ps(ay, ax, _CMP_GT_OQ));
+        r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(PI), r), _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LT_OQ));
+        return _mm256_xor_ps(r, _mm256_and_ps(y, signMask));
+    }
+
+    CPU_TARGET("avx2,fma")
+    unsigned int projectAVX2(const FaceBasis& f, const float* sc, float tc, unsigned int count, float* u, float* v) {
+        const __m256 Sx = _mm256_set1_ps(f.S[0]), Sy = _mm256_set1_ps(f.S[1]), Sz = _mm256_set1_ps(f.S[2]);
+        const __m256 kx = _mm256_set1_ps(f.T[0] * tc + f.C[0]);
+        const __m256 ky = _mm256_set1_ps(f.T[1] * tc + f.C[1]);
+        const __m256 kz = _mm256_set1_ps(f.T[2] * tc + f.C[2]);
+        const __m256 invU = _mm256_set1_ps(INV_ATAN_U), invV = _mm256_set1_ps(INV_ATAN_V), half = _mm256_set1_ps(0.5f);
+
+        unsigned int i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256 c = _mm256_loadu_ps(sc + i);
+            __m256 x = _mm256_fmadd_ps(Sx, c, kx);
+            __m256 y = _mm256_fmadd_ps(Sy, c, ky);
+            __m256 z = _mm256_fmadd_ps(Sz, c, kz);
+            __m256 xz = _mm256_sqrt_ps(_mm256_fmadd_ps(x, x, _mm256_mul_ps(z, z)));
+            _mm256_storeu_ps(u + i, _mm256_fmadd_ps(atan2AVX2(z, x), invU, half));
+            _mm256_storeu_ps(v + i, _mm256_fmadd_ps(atan2AVX2(y, xz), invV, half));
+        }
+        return i;
+    }
+
+    CPU_TARGET("sse2")
+    __m128 atan2SSE2(__m128 y, __m128 x) {
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        __m128 ax = _mm_andnot_ps(signMask, x);
+        __m128 ay = _mm_andnot_ps(signMask, y);
+        __m128 a = _mm_div_ps(_mm_min_ps(ax, ay), _mm_max_ps(_mm_max_ps(ax, ay), _mm_set1_ps(1e-30f)));
+        __m128 s = _mm_mul_ps(a, a);
+        __m128 p = _mm_add_ps(_mm_mul_ps(s, _mm_set1_ps(ATAN_C5)), _mm_set1_ps(ATAN_C4));
+        p = _mm_add_ps(_mm_mul_ps(s, p), _mm_set1_ps(ATAN_C3));
+        p = _mm_add_ps(_mm_mul_ps(s, p), _mm_set1_ps(ATAN_C2));
+        p = _mm_add_ps(_mm_mul_ps(s, p), _mm_set1_ps(ATAN_C1));
+        p = _mm_add_ps(_mm_mul_ps(s, p), _mm_set1_ps(ATAN_C0));
+        __m128 r = _mm_mul_ps(a, p);
+
+        // No blendv before SSE4.1: select with and/andnot masks
+        __m128 steep = _mm_cmpgt_ps(ay, ax);
+        r = _mm_or_ps(_mm_and_ps(steep, _mm_sub_ps(_mm_set1_ps(0.5f * PI), r)), _mm_andnot_ps(steep, r));
+        __m128 negX = _mm_cmplt_ps(x, _mm_setzero_ps());
+        r = _mm_or_ps(_mm_and_ps(negX, _mm_sub_ps(_mm_set1_ps(PI), r)), _mm_andnot_ps(negX, r));
+        return _mm_xor_ps(r, _mm_and_ps(y, signMask));
+    }
+
+    CPU_TARGET("sse2")
+    unsigned int projectSSE2(const FaceBasis& f, const float* sc, float tc, unsigned int count, float* u, float* v) {
+        const __m128 Sx = _mm_set1_ps(f.S[0]), Sy = _mm_set1_ps(f.S[1]), Sz = _mm_set1_ps(f.S[2]);
+        const __m128 kx = _mm_set1_ps(f.T[0] * tc + f.C[0]);
+        const __m128 ky = _mm_set1_ps(f.T[1] * tc + f.C[1]);
+        const __m128 kz = _mm_set1_ps(f.T[2] * tc + f.C[2]);
+        const __m128 invU = _mm_set1_ps(INV_ATAN_U), invV = _mm_set1_ps(INV_ATAN_V), half = _mm_set1_ps(0.5f);
+
+        unsigned int i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128 c = _mm_loadu_ps(sc + i);
+            __m128 x = _mm_add_ps(_mm_mul_ps(Sx, c), kx);
+            __m128 y = _mm_add_ps(_mm_mul_ps(Sy, c), ky);
+            __m128 z = _mm_add_ps(_mm_mul_ps(Sz, c), kz);
+            __m128 xz = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(z, z)));
+            _mm_storeu_ps(u + i, _mm_add_ps(_mm_mul_ps(atan2SSE2(z, x), invU), half));
+            _mm_storeu_ps(v + i, _mm_add_ps(_mm_mul_ps(atan2SSE2(y, xz), invV), half));
+        }
+        return i;
+    }
+#endif
+}
+
+EquirectProjection::EquirectProjection(unsigned int size)
+    : _size(size), _coords(size) {
+
+    for (unsigned int i = 0; i < size; i++)
+        _coords[i] = 2.0f * (i + 0.5f) / size - 1.0f;
+}
+
+unsigned int EquirectProjection::size() const {
+    return _size;
+}
+
+void EquirectProjection::projectRow(unsigned int face, unsigned int y, float* u, float* v) const {
+    const FaceBasis& f = FACES[face];
+    const float* sc = _coords.data();
+    float tc = _coords[y];
+
+    unsigned int i = 0;
+#ifdef CPU_X86
+    i = CPUFeatures::hasAVX2() ? projectAVX2(f, sc, tc, _size, u, v) : projectSSE2(f, sc, tc, _size, u, v);
+#endif
+    projectScalar(f, sc, tc, i, _size, u, v);
+}
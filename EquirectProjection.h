@@ -0,0 +1,27 @@
+#ifndef __XGP_EQUIRECTPROJECTION_H__
+#define __XGP_EQUIRECTPROJECTION_H__
+
+#include <vector>
+
+// Equirectangular coordinates of cubemap texels, the math of equirectangular.fs
+// vectorized for the CPU baker. atan2 and asin are replaced by a polynomial atan
+// (about 1e-5 radians of error), evaluated 8 texels at a time with AVX2 when the CPU
+// supports it, 4 at a time with SSE2 otherwise, and one at a time off x86.
+class EquirectProjection {
+public:
+	// Builds the face coordinates of a face size, shared by every face and image
+	EquirectProjection(unsigned int size);
+
+	unsigned int size() const;
+
+	// (u, v) in the equirectangular image of the size texels of one row of a face,
+	// matching SampleSphericalMap() in equirectangular.fs
+	void projectRow(unsigned int face, unsigned int y, float* u, float* v) const;
+
+private:
+	unsigned int _size;
+	// Cubemap face coordinate of every row / column center, in [-1, 1]
+	std::vector<float> _coords;
+};
+
+#endif
@@ -0,0 +1,187 @@
+#include "EquirectSAT.h"
+
+#include <Utils.h>
+
+#include <algorithm>
+#include <cmath>
+
+// Texels summed relative to the same double corner, see EquirectSAT.h
+#define SAT_TILE 16
+// Fixed point unit of the tile sums, a bit of headroom below 2^31 absorbs the rounding of the step
+#define SAT_UNITS (double)(1 << 30)
+
+static const double PI = 3.14159265358979323846;
+
+namespace {
+    // Halves an RGB float image with a 2x2 box filter, the last row or column of an odd size is repeated
+    std::vector<float> halve(const float* src, int width, int height, int& halfWidth, int& halfHeight) {
+        halfWidth = std::max(1, width / 2);
+        halfHeight = std::max(1, height / 2);
+        std::vector<float> dst(3 * (size_t)halfWidth * halfHeight);
+        Utils::parallelFor(halfHeight, [&](unsigned int y) {
+            const float* row0 = &src[3 * (size_t)std::min(2 * (int)y, height - 1) * width];
+            const float* row1 = &src[3 * (size_t)std::min(2 * (int)y + 1, height - 1) * width];
+            float* out = &dst[3 * (size_t)y * halfWidth];
+            for (int x = 0; x < halfWidth; x++) {
+                int x0 = 3 * std::min(2 * x, width - 1);
+                int x1 = 3 * std::min(2 * x + 1, width - 1);
+                for (int c = 0; c < 3; c++)
+                    out[3 * x + c] = 0.25f * (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c]);
+            }
+        });
+        return dst;
+    }
+}
+
+EquirectSAT::EquirectSAT(const float* data, int width, int height, int maxWidth) {
+    std::vector<float> reduced;
+    const float* texels = data;
+    while (width > maxWidth && width > 1) {
+        reduced = halve(texels, width, height, width, height);
+        texels = reduced.data();
+    }
+    _width = width;
+    _height = height;
+
+    // Rows are bottom-up: row y spans latitudes around (y + 0.5) / height * PI - PI / 2,
+    // and its texels cover a solid angle proportional to the cosine of that latitude
+    std::vector<double> weights(_height);
+    _rowWeights.assign(_height + 1, 0.0);
+    for (int y = 0; y < _height; y++) {
+        weights[y] = std::cos(((y + 0.5) / _height - 0.5) * PI);
+        _rowWeights[y + 1] = _rowWeights[y] + weights[y];
+    }
+
+    // With S(x, y) the sum over [0, x) x [0, y) and (X, Y) the corner of the tile holding
+    // (x, y), S(x, y) = S(X, y) + S(x, Y) - S(X, Y) + the sum over [X, x) x [Y, y).
+    // The first two are kept in double along the tile edges, the last one in fixed point.
+    size_t stride = (size_t)_width + 1;
+    _tileColumns = _width / SAT_TILE + 1;
+    unsigned int tileRows = _height / SAT_TILE + 1;
+    _local.resize(stride * (_height + 1));
+    _steps.resize((size_t)_tileColumns * tileRows);
+    _columns.assign((size_t)_tileColumns * (_height + 1), glm::dvec3(0.0));
+    _rows.assign(stride * tileRows, glm::dvec3(0.0));
+
+    // Each band of tile rows sums its rows in double from its bottom edge. The band
+    // totals and the row sums at the tile column edges are accumulated afterwards.
+    Utils::parallelFor(tileRows, [&](unsigned int band) {
+        // No sum inside a tile exceeds the sum of its absolute values, which sets its step
+        int begin = band * SAT_TILE;
+        int end = std::min(begin + SAT_TILE, _height + 1);
+        std::vector<glm::dvec3> bounds(_tileColumns, glm::dvec3(0.0));
+        for (int y = begin; y < std::min(end, _height); y++) {
+            const float* src = texels + 3 * (size_t)y * _width;
+            for (int x = 0; x < _width; x++)
+                bounds[x / SAT_TILE] += glm::abs(glm::dvec3(src[3 * x], src[3 * x + 1], src[3 * x + 2])) * weights[y];
+        }
+        std::vector<glm::dvec3> scales(_tileColumns);
+        for (int c = 0; c < _tileColumns; c++) {
+            glm::vec3 step = glm::vec3(bounds[c] / SAT_UNITS);
+            _steps[band * (size_t)_tileColumns + c] = step;
+            for (int i = 0; i < 3; i++)
+                scales[c][i] = step[i] > 0.0f ? 1.0 / step[i] : 0.0;
+        }
+
+        std::vector<glm::dvec3> row(stride);
+        std::vector<glm::dvec3> bandSum(stride, glm::dvec3(0.0));
+        for (int y = begin; y < end; y++) {
+            glm::ivec3* local = &_local[y * stride];
+            for (int x = 0; x <= _width; x++) {
+                int column = x / SAT_TILE;
+                local[x] = glm::ivec3(glm::round((bandSum[x] - bandSum[column * SAT_TILE]) * scales[column]));
+            }
+            if (y == _height)
+                break;
+
+            const float* src = texels + 3 * (size_t)y * _width;
+            row[0] = glm::dvec3(0.0);
+            for (int x = 0; x < _width; x++)
+                row[x + 1] = row[x] + glm::dvec3(src[3 * x], src[3 * x + 1], src[3 * x + 2]) * weights[y];
+            for (int x = 0; x <= _width; x++)
+                bandSum[x] += row[x];
+            for (int c = 0; c < _tileColumns; c++)
+                _columns[(y + 1) * (size_t)_tileColumns + c] = row[c * SAT_TILE];
+        }
+        if (band + 1 < tileRows)
+            std::copy(bandSum.begin(), bandSum.end(), _rows.begin() + (band + 1) * stride);
+    });
+
+    Utils::parallelFor(_tileColumns, [&](unsigned int c) {
+        for (int y = 1; y <= _height; y++)
+            _columns[y * (size_t)_tileColumns + c] += _columns[(y - 1) * (size_t)_tileColumns + c];
+    });
+
+    const unsigned int COLUMN_BLOCK = 256;
+    unsigned int blocks = (unsigned int)((stride + COLUMN_BLOCK - 1) / COLUMN_BLOCK);
+    Utils::parallelFor(blocks, [&](unsigned int block) {
+        size_t x0 = (size_t)block * COLUMN_BLOCK;
+        size_t x1 = std::min(x0 + COLUMN_BLOCK, stride);
+        for (unsigned int b = 1; b < tileRows; b++) {
+            glm::dvec3* row = &_rows[b * stride];
+            const glm::dvec3* below = row - stride;
+            for (size_t x = x0; x < x1; x++)
+                row[x] += below[x];
+        }
+    });
+}
+
+int EquirectSAT::width() const {
+    return _width;
+}
+
+int EquirectSAT::height() const {
+    return _height;
+}
+
+glm::dvec3 EquirectSAT::table(int x, int y) const {
+    size_t stride = (size_t)_width + 1;
+    size_t column = x / SAT_TILE;
+    size_t edge = y / SAT_TILE;
+    glm::dvec3 local = glm::dvec3(_local[y * stride + x]) * glm::dvec3(_steps[edge * _tileColumns + column]);
+    return _columns[y * (size_t)_tileColumns + column] + _rows[edge * stride + x] -
+           _columns[edge * SAT_TILE * (size_t)_tileColumns + column] + local;
+}
+
+glm::dvec3 EquirectSAT::integral(double x, double y) const {
+    x = std::clamp(x, 0.0, (double)_width);
+    y = std::clamp(y, 0.0, (double)_height);
+    int ix = std::min((int)x, _width - 1);
+    int iy = std::min((int)y, _height - 1);
+    double tx = x - ix;
+    double ty = y - iy;
+
+    glm::dvec3 bottom = table(ix, iy) + (table(ix + 1, iy) - table(ix, iy)) * tx;
+    glm::dvec3 top = table(ix, iy + 1) + (table(ix + 1, iy + 1) - table(ix, iy + 1)) * tx;
+    return bottom + (top - bottom) * ty;
+}
+
+glm::dvec3 EquirectSAT::rectangle(double x0, double x1, double y0, double y1) const {
+    return integral(x1, y1) - integral(x0, y1) - integral(x1, y0) + integral(x0, y0);
+}
+
+glm::vec3 EquirectSAT::average(float u0, float u1, float v0, float v1) const {
+    // Footprints are never degenerate, but keep a minimal extent so that the weight can't vanish
+    const double MIN_EXTENT = 1e-3;
+    double x0 = (double)u0 * _width;
+    double x1 = std::max((double)u1 * _width, x0 + MIN_EXTENT);
+    double y0 = std::clamp((double)v0 * _height, 0.0, _height - MIN_EXTENT);
+    double y1 = std::clamp((double)v1 * _height, y0 + MIN_EXTENT, (double)_height);
+
+    // Split the longitude range where it wraps
+    glm::dvec3 sum;
+    if (x0 < 0.0)
+        sum = rectangle(x0 + _width, _width, y0, y1) + rectangle(0.0, x1, y0, y1);
+    else if (x1 > _width)
+        sum = rectangle(x0, _width, y0, y1) + rectangle(0.0, x1 - _width, y0, y1);
+    else
+        sum = rectangle(x0, x1, y0, y1);
+
+    // Row weights interpolate like the table
+    auto rowWeight = [&](double y) {
+        int iy = std::min((int)y, _height - 1);
+        return _rowWeights[iy] + (_rowWeights[iy + 1] - _rowWeights[iy]) * (y - iy);
+    };
+    double weight = (x1 - x0) * (rowWeight(y1) - rowWeight(y0));
+    return glm::vec3(sum / weight);
+}
@@ -0,0 +1,48 @@
+#ifndef __XGP_EQUIRECTSAT_H__
+#define __XGP_EQUIRECTSAT_H__
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Summed-area table of an equirectangular image, weighted by the solid angle of its
+// rows, so that the average radiance over any longitude / latitude rectangle costs
+// four lookups whatever its size. Images much larger than needed are first halved
+// with a box filter, which keeps the integrals exact.
+// The image is split in 16 x 16 tiles. The sums are kept in double along the tile
+// edges only, and relative to the corner of their tile everywhere else, in 32 bit
+// fixed point scaled to the tile: 15 bytes per texel of the (halved) image, for an
+// error within 1e-9 of the tile's total, so only texels next to a sun pick some of it.
+class EquirectSAT {
+public:
+	// data is bottom-up RGB float, as loaded with stbi_set_flip_vertically_on_load(true).
+	// The image is halved until it is at most maxWidth wide.
+	EquirectSAT(const float* data, int width, int height, int maxWidth);
+
+	int width() const;
+	int height() const;
+
+	// Solid angle weighted average over [u0, u1] x [v0, v1], in the texture coordinates
+	// of the image. u may extend past 0 or 1 by up to a whole turn, it wraps around.
+	glm::vec3 average(float u0, float u1, float v0, float v1) const;
+
+private:
+	// Sum over [0, x) x [0, y), for texel corners x in [0, width] and y in [0, height]
+	glm::dvec3 table(int x, int y) const;
+	// Integral over [0, x] x [0, y] in texels, bilinear between the table entries,
+	// which is exact for an image of constant texels
+	glm::dvec3 integral(double x, double y) const;
+	// Integral over [x0, x1] x [y0, y1] in texels, for x0 <= x1 within [0, width]
+	glm::dvec3 rectangle(double x0, double x1, double y0, double y1) const;
+
+	int _width;
+	int _height;
+	int _tileColumns;                   // tile columns + 1, the last edge is at or before width
+	std::vector<glm::ivec3> _local;     // (width + 1) x (height + 1), sums from the corner of their tile
+	std::vector<glm::vec3> _steps;      // value of a _local unit, per tile
+	std::vector<glm::dvec3> _columns;   // sums at every tile column edge, for every row
+	std::vector<glm::dvec3> _rows;      // sums at every tile row edge, for every column
+	std::vector<double> _rowWeights;    // prefix sums of the row solid angle weights, height + 1
+};
+
+#endif
@@ -0,0 +1,78 @@
+#include "GGXSamples.h"
+
+#include <algorithm>
+#include <cmath>
+
+static const float PI = 3.14159265359f;
+
+namespace {
+    float radicalInverse(unsigned int bits) {
+        bits = (bits << 16u) | (bits >> 16u);
+        bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+        bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+        bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+        bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+        return (float)bits * 2.3283064365386963e-10f; // / 0x100000000
+    }
+}
+
+std::vector<glm::vec4> GGXSamples::build(float roughness, unsigned int sampleCount, unsigned int sourceRes) {
+    float a = roughness * roughness;
+    float a2 = a * a;
+    float saTexel = 4.0f * PI / (6.0f * (float)sourceRes * (float)sourceRes);
+
+    std::vector<glm::vec4> samples;
+    samples.reserve(sampleCount);
+    for (unsigned int i = 0; i < sampleCount; i++) {
+        glm::vec2 Xi = glm::vec2((float)i / (float)sampleCount, radicalInverse(i));
+
+        float phi = 2.0f * PI * Xi.x;
+        float cosTheta = std::sqrt((1.0f - Xi.y) / (1.0f + (a2 - 1.0f) * Xi.y));
+        float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+        glm::vec3 H = glm::vec3(std::cos(phi) * sinTheta, std::sin(phi) * sinTheta, cosTheta);
+        // reflect(-V, H) with V = N = +Z
+        glm::vec3 L = glm::normalize(2.0f * H.z * H - glm::vec3(0.0f, 0.0f, 1.0f));
+
+        float NdotL = L.z;
+        if (NdotL <= 0.0f)
+            continue;
+
+        // Sample from the environment's mip level based on roughness/pdf, NdotH == HdotV
+        float NdotH = std::max(H.z, 0.0f);
+        float denom = NdotH * NdotH * (a2 - 1.0f) + 1.0f;
+        float D = a2 / (PI * denom * denom);
+        float pdf = D * NdotH / (4.0f * NdotH) + 0.0001f;
+
+        float saSample = 1.0f / ((float)sampleCount * pdf + 0.0001f);
+        float mipLevel = roughness == 0.0f ? 0.0f : 0.5f * std::log2(saSample / saTexel);
+
+        samples.push_back(glm::vec4(L, mipLevel));
+    }
+    return samples;
+}
+
+unsigned int GGXSamples::sampleCount(float roughness) {
+    // Power of two counts keep the Hammersley set well stratified
+    unsigned int count = 64;
+    while (count < PREFILTER_SAMPLE_COUNT && (float)count < roughness * (float)PREFILTER_SAMPLE_COUNT)
+        count *= 2;
+    return count;
+}
+
+unsigned int GGXSamples::count(const BakeOptions& options, unsigned int mip) {
+    if (mip == 0)
+        return 1;
+    if (options.prefilterSamples != 0)
+        return options.prefilterSamples;
+    return sampleCount((float)mip / (float)(options.prefilterLevels - 1));
+}
+
+std::vector<glm::vec4> GGXSamples::level(const BakeOptions& options, unsigned int mip) {
+    if (mip == 0) {
+        float lod = std::log2((float)options.envRes / (float)options.prefilterRes);
+        return std::vector<glm::vec4>(1, glm::vec4(0.0f, 0.0f, 1.0f, std::max(0.0f, lod)));
+    }
+
+    float roughness = (float)mip / (float)(options.prefilterLevels - 1);
+    return build(roughness, count(options, mip), options.envRes);
+}
@@ -0,0 +1,36 @@
+#ifndef __XGP_GGXSAMPLES_H__
+#define __XGP_GGXSAMPLES_H__
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include <Bake.h>
+
+// Most samples a prefilter level takes, reached at the highest roughness
+#define PREFILTER_SAMPLE_COUNT 4096u
+
+namespace GGXSamples {
+	// Hammersley importance samples of the GGX lobe with V = N, the assumption of the
+	// prefilter pass. Everything but the final basis rotation then only depends on the
+	// sample index and the roughness, so a level is baked from one table shared by all
+	// of its texels. Holds the tangent space L (z is NdotL) and the source mip level of
+	// the samples with NdotL > 0, in sample order. sourceRes is the size of the
+	// environment map faces, which the mip level selection depends on.
+	std::vector<glm::vec4> build(float roughness, unsigned int sampleCount, unsigned int sourceRes);
+
+	// Samples taken for a roughness when BakeOptions::prefilterSamples is 0: the lobe
+	// narrows with the roughness and filtered importance sampling gives each sample a
+	// footprint to match, so fewer samples cover it equally well
+	unsigned int sampleCount(float roughness);
+
+	// Samples drawn for one prefilter level, before the ones under the horizon are dropped
+	unsigned int count(const BakeOptions& options, unsigned int mip);
+
+	// Table of one prefilter level. The first level has no roughness and is a single
+	// sample along the normal, from the environment mip matching its resolution:
+	// a straight downsample of the environment map.
+	std::vector<glm::vec4> level(const BakeOptions& options, unsigned int mip);
+}
+
+#endif
@@ -0,0 +1,174 @@
+#include "GLContext.h"
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#ifdef PBRBAKER_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <cstdio>
+#include <cstring>
+
+namespace {
+    void errorCallback(int error, const char* description) {
+        fprintf(stderr, "Error: %s\n", description);
+    }
+
+#ifdef PBRBAKER_EGL
+    bool hasExtension(const char* extensions, const char* name) {
+        if (!extensions)
+            return false;
+        size_t length = std::strlen(name);
+        for (const char* s = std::strstr(extensions, name); s; s = std::strstr(s + length, name)) {
+            if ((s == extensions || s[-1] == ' ') && (s[length] == ' ' || s[length] == '\0'))
+                return true;
+        }
+        return false;
+    }
+#endif
+}
+
+GLContext::GLContext()
+    : _window(nullptr), _eglDisplay(nullptr), _eglContext(nullptr) {
+
+}
+
+GLContext::~GLContext() {
+    destroy();
+}
+
+bool GLContext::create(bool headless) {
+    if (!(headless ? createSurfaceless() : createWindow())) {
+        destroy();
+        return false;
+    }
+
+    glewExperimental = GL_TRUE;
+    GLenum err = glewInit();
+    // A GLX build of GLEW still loads the GL functions without an X display, it only fails on GLX itself
+    if (err != GLEW_OK && !(headless && err == GLEW_ERROR_NO_GLX_DISPLAY)) {
+        _error = std::string("Failed to initialize GLEW: ") + (const char*)glewGetErrorString(err);
+        destroy();
+        return false;
+    }
+    if (!GLEW_VERSION_3_3) {
+        _error = "OpenGL 3.3 is not supported";
+        destroy();
+        return false;
+    }
+    return true;
+}
+
+void GLContext::destroy() {
+    if (_window) {
+        glfwDestroyWindow(_window);
+        glfwTerminate();
+        _window = nullptr;
+    }
+#ifdef PBRBAKER_EGL
+    if (_eglDisplay) {
+        eglMakeCurrent((EGLDisplay)_eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (_eglContext)
+            eglDestroyContext((EGLDisplay)_eglDisplay, (EGLContext)_eglContext);
+        eglTerminate((EGLDisplay)_eglDisplay);
+        _eglDisplay = nullptr;
+        _eglContext = nullptr;
+    }
+#endif
+}
+
+const std::string& GLContext::error() const {
+    return _error;
+}
+
+bool GLContext::createWindow() {
+    glfwSetErrorCallback(errorCallback);
+    if (!glfwInit()) {
+        _error = "Failed to initialize GLFW";
+        return false;
+    }
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    // The window only carries the context: keep it hidden and its framebuffer as small as possible
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_SAMPLES, 0);
+    glfwWindowHint(GLFW_DEPTH_BITS, 0);
+    glfwWindowHint(GLFW_STENCIL_BITS, 0);
+
+    _window = glfwCreateWindow(1, 1, "PBR Baker", NULL, NULL);
+    if (!_window) {
+        glfwTerminate();
+        _error = "Failed to create GLFW window";
+        return false;
+    }
+    glfwMakeContextCurrent(_window);
+    return true;
+}
+
+bool GLContext::createSurfaceless() {
+#ifdef PBRBAKER_EGL
+    // Prefer Mesa's surfaceless platform, which works without X11, Wayland or even a GPU
+    EGLDisplay display = EGL_NO_DISPLAY;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay && hasExtension(eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS), "EGL_MESA_platform_surfaceless"))
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (display == EGL_NO_DISPLAY)
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+        _error = "Failed to initialize EGL";
+        return false;
+    }
+    _eglDisplay = display;
+
+    if (!hasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context")) {
+        _error = "EGL_KHR_surfaceless_context is not supported";
+        return false;
+    }
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        _error = "EGL does not support desktop OpenGL";
+        return false;
+    }
+
+    // No surface will ever be created, any config able to render OpenGL does
+    const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, 0,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint configCount = 0;
+    if (!eglChooseConfig(display, configAttribs, &config, 1, &configCount) || configCount == 0) {
+        _error = "No EGL config supports OpenGL";
+        return false;
+    }
+
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+        EGL_CONTEXT_MINOR_VERSION_KHR, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+        EGL_NONE
+    };
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+    if (context == EGL_NO_CONTEXT) {
+        _error = "Failed to create an OpenGL 3.3 core EGL context";
+        return false;
+    }
+    _eglContext = context;
+
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        _error = "Failed to make the EGL context current";
+        return false;
+    }
+    return true;
+#else
+    _error = "Headless contexts need a build with PBRBAKER_EGL defined and libEGL linked";
+    return false;
+#endif
+}
@@ -0,0 +1,38 @@
+#ifndef __XGP_GLCONTEXT_H__
+#define __XGP_GLCONTEXT_H__
+
+#include <string>
+
+struct GLFWwindow;
+
+// OpenGL 3.3 core context the Baker renders with. Baking only ever draws into its
+// own framebuffers, so no context has a visible window nor a multisampled default
+// framebuffer.
+class GLContext {
+public:
+	GLContext();
+	~GLContext();
+
+	GLContext(const GLContext&) = delete;
+	GLContext& operator=(const GLContext&) = delete;
+
+	// Creates the context and makes it current, then loads the GL functions with GLEW.
+	// headless uses a surfaceless EGL context, which needs no window system and runs
+	// on servers and CI under Mesa llvmpipe. It requires building with PBRBAKER_EGL
+	// defined and linking libEGL. Otherwise a hidden GLFW window provides the context.
+	bool create(bool headless);
+	void destroy();
+
+	const std::string& error() const;
+
+private:
+	bool createWindow();
+	bool createSurfaceless();
+
+	GLFWwindow* _window;
+	void* _eglDisplay;
+	void* _eglContext;
+	std::string _error;
+};
+
+#endif
@@ -0,0 +1,207 @@
+#include "HDRImage.h"
+
+#include <Utils.h>
+#include <stb_image.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#define SCANLINES_PER_JOB 16
+
+namespace {
+    // Reads one '\n' terminated header line, returns false past the end of the file
+    bool readLine(const std::vector<unsigned char>& file, size_t& pos, std::string& line) {
+        if (pos >= file.size())
+            return false;
+
+        line.clear();
+        while (pos < file.size() && file[pos] != '\n')
+            line.push_back((char)file[pos++]);
+        pos++;
+        return true;
+    }
+
+    // Same conversion as stbi__hdr_convert
+    void rgbeToFloat(const unsigned char* rgbe, float* output) {
+        if (rgbe[3] != 0) {
+            float f = (float)ldexp(1.0f, rgbe[3] - (int)(128 + 8));
+            output[0] = rgbe[0] * f;
+            output[1] = rgbe[1] * f;
+            output[2] = rgbe[2] * f;
+        }
+        else {
+            output[0] = output[1] = output[2] = 0.0f;
+        }
+    }
+
+    // Walks the four channel runs of the RLE scanline starting at pos. When rgbe is
+    // given, the decoded channels are interleaved into it. Returns the offset just
+    // past the scanline, or 0 if the scanline is malformed or truncated.
+    size_t readRLEScanline(const std::vector<unsigned char>& file, size_t pos, int width, unsigned char* rgbe) {
+        if (pos + 4 > file.size() || file[pos] != 2 || file[pos + 1] != 2 || ((file[pos + 2] << 8) | file[pos + 3]) != width)
+            return 0;
+        pos += 4;
+
+        for (int k = 0; k < 4; k++) {
+            int i = 0;
+            while (i < width) {
+                if (pos >= file.size())
+                    return 0;
+
+                int count = file[pos++];
+                bool run = count > 128;
+                if (run)
+                    count -= 128;
+                if (count == 0 || count > width - i || pos + (run ? 1 : count) > file.size())
+                    return 0;
+
+                if (rgbe) {
+                    for (int n = 0; n < count; n++)
+                        rgbe[(i + n) * 4 + k] = file[run ? pos : pos + n];
+                }
+                i += count;
+                pos += run ? 1 : count;
+            }
+        }
+        return pos;
+    }
+}
+
+HDRImage::HDRImage()
+    : _width(0), _height(0) {
+
+}
+
+bool HDRImage::load(const std::string& filepath, bool flipVertically) {
+    _width = _height = 0;
+    _data.clear();
+    _error.clear();
+
+    std::ifstream input(filepath, std::ios_base::in | std::ios_base::binary);
+    if (input.fail()) {
+        _error = "can't fopen";
+        return false;
+    }
+    std::vector<unsigned char> file((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    return load(file, flipVertically);
+}
+
+bool HDRImage::load(const std::vector<unsigned char>& file, bool flipVertically) {
+    _width = _height = 0;
+    _data.clear();
+    _error.clear();
+
+    static const char radiance[] = "#?RADIANCE\n";
+    static const char rgbe[] = "#?RGBE\n";
+    if ((file.size() >= sizeof(radiance) - 1 && std::memcmp(file.data(), radiance, sizeof(radiance) - 1) == 0) ||
+        (file.size() >= sizeof(rgbe) - 1 && std::memcmp(file.data(), rgbe, sizeof(rgbe) - 1) == 0)) {
+        return loadRadiance(file, flipVertically);
+    }
+
+    // Not a Radiance file, let stb_image handle it. Images are decoded from several
+    // threads, so the flip flag must be the calling thread's own, and the failure
+    // reason is not read back from stb_image's global state.
+    int nrComponents;
+    stbi_set_flip_vertically_on_load_thread(flipVertically);
+    float* data = stbi_loadf_from_memory(file.data(), (int)file.size(), &_width, &_height, &nrComponents, 3);
+    if (!data) {
+        _error = stbi_info_from_memory(file.data(), (int)file.size(), &_width, &_height, &nrComponents) ? "corrupt image" : "unknown image type";
+        _width = _height = 0;
+        return false;
+    }
+    _data.assign(data, data + (size_t)_width * _height * 3);
+    stbi_image_free(data);
+    return true;
+}
+
+bool HDRImage::loadRadiance(const std::vector<unsigned char>& file, bool flipVertically) {
+    size_t pos = 0;
+    std::string line;
+    readLine(file, pos, line);
+
+    bool valid = false;
+    while (readLine(file, pos, line) && !line.empty()) {
+        if (line == "FORMAT=32-bit_rle_rgbe")
+            valid = true;
+    }
+    if (!valid) {
+        _error = "unsupported format";
+        return false;
+    }
+
+    int width, height;
+    if (!readLine(file, pos, line) || std::sscanf(line.c_str(), "-Y %d +X %d", &height, &width) != 2) {
+        _error = "unsupported data layout";
+        return false;
+    }
+    if (width <= 0 || height <= 0 || width > (1 << 24) || height > (1 << 24)) {
+        _error = "too large";
+        return false;
+    }
+
+    // Index every scanline. Like stb_image, the image is either entirely RLE or
+    // entirely flat depending on its first scanline.
+    bool rle = width >= 8 && width < 32768 && pos + 4 <= file.size() &&
+               file[pos] == 2 && file[pos + 1] == 2 && !(file[pos + 2] & 0x80);
+    std::vector<size_t> offsets(height);
+    for (int y = 0; y < height; y++) {
+        offsets[y] = pos;
+        pos = rle ? readRLEScanline(file, pos, width, nullptr) : pos + (size_t)width * 4;
+        if (pos == 0 || pos > file.size()) {
+            _error = "bad RLE data in HDR";
+            return false;
+        }
+    }
+
+    // Decode and convert chunks of scanlines in parallel, straight into their final row
+    _data.resize((size_t)width * height * 3);
+    std::atomic<bool> failed(false);
+    unsigned int jobs = (height + SCANLINES_PER_JOB - 1) / SCANLINES_PER_JOB;
+    Utils::parallelFor(jobs, [&](unsigned int job) {
+        std::vector<unsigned char> scanline(rle ? (size_t)width * 4 : 0);
+        int end = std::min(height, (int)(job + 1) * SCANLINES_PER_JOB);
+        for (int y = job * SCANLINES_PER_JOB; y < end; y++) {
+            const unsigned char* rgbe = &file[offsets[y]];
+            if (rle) {
+                if (readRLEScanline(file, offsets[y], width, scanline.data()) == 0) {
+                    failed = true;
+                    return;
+                }
+                rgbe = scanline.data();
+            }
+
+            float* row = &_data[(size_t)(flipVertically ? height - 1 - y : y) * width * 3];
+            for (int x = 0; x < width; x++)
+                rgbeToFloat(&rgbe[x * 4], &row[x * 3]);
+        }
+    });
+    if (failed) {
+        _data.clear();
+        _error = "bad RLE data in HDR";
+        return false;
+    }
+
+    _width = width;
+    _height = height;
+    return true;
+}
+
+int HDRImage::width() const {
+    return _width;
+}
+
+int HDRImage::height() const {
+    return _height;
+}
+
+const float* HDRImage::data() const {
+    return _data.data();
+}
+
+const std::string& HDRImage::error() const {
+    return _error;
+}
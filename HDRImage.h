@@ -0,0 +1,34 @@
+#ifndef __XGP_HDRIMAGE_H__
+#define __XGP_HDRIMAGE_H__
+
+#include <string>
+#include <vector>
+
+// RGB float image. Radiance .hdr files are decoded in parallel: the RLE stream
+// is first indexed to find where every scanline starts, then scanlines are
+// decoded and converted from RGBE straight into their final row. Any other
+// format goes through stbi_loadf.
+class HDRImage {
+public:
+	HDRImage();
+
+	// Loads the image bottom-up when flipVertically is set, like stbi_set_flip_vertically_on_load_thread(true)
+	bool load(const std::string& filepath, bool flipVertically = true);
+	// Same as above for a file already read into memory
+	bool load(const std::vector<unsigned char>& file, bool flipVertically = true);
+
+	int width() const;
+	int height() const;
+	const float* data() const;
+	const std::string& error() const;
+
+private:
+	bool loadRadiance(const std::vector<unsigned char>& file, bool flipVertically);
+
+	int _width;
+	int _height;
+	std::vector<float> _data;
+	std::string _error;
+};
+
+#endif
@@ -0,0 +1,113 @@
+#include "Half.h"
+
+#include <CPUFeatures.h>
+
+#include <cstdint>
+#include <cstring>
+
+namespace {
+#ifdef CPU_X86
+    CPU_TARGET("avx,f16c")
+    size_t fromFloatF16C(const float* src, glm::uint16* dst, size_t count) {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256 f = _mm256_loadu_ps(src + i);
+            _mm_storeu_si128((__m128i*)(dst + i), _mm256_cvtps_ph(f, _MM_FROUND_TO_NEAREST_INT));
+        }
+        return i;
+    }
+
+    // Branchless round to nearest even conversion of 4 floats, after F. Giesen's float_to_half_SSE2
+    CPU_TARGET("sse2")
+    __m128i fromFloatSSE2x4(__m128 f) {
+        const __m128i c_f16max = _mm_set1_epi32((127 + 16) << 23);              // all FP32 values >= this round to +inf
+        const __m128i c_nanbit = _mm_set1_epi32(0x200);
+        const __m128i c_infty_as_fp16 = _mm_set1_epi32(0x7c00);
+        const __m128i c_min_normal = _mm_set1_epi32((127 - 14) << 23);          // smallest FP32 that yields a normalized FP16
+        const __m128i c_subnorm_magic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+        const __m128i c_normal_bias = _mm_set1_epi32(0xfff - ((127 - 15) << 23)); // adjust exponent and add mantissa rounding
+
+        __m128 justsign = _mm_and_ps(_mm_castsi128_ps(_mm_set1_epi32((int)0x80000000u)), f);
+        __m128 absf = _mm_xor_ps(f, justsign);
+        __m128i absf_int = _mm_castps_si128(absf);
+        __m128 b_isnan = _mm_cmpunord_ps(absf, absf);
+        __m128i b_isregular = _mm_cmpgt_epi32(c_f16max, absf_int);
+        __m128i nanbit = _mm_and_si128(_mm_castps_si128(b_isnan), c_nanbit);
+        __m128i inf_or_nan = _mm_or_si128(nanbit, c_infty_as_fp16);
+        __m128i b_issub = _mm_cmpgt_epi32(c_min_normal, absf_int);
+
+        // Subnormal results: let the FP adder round the mantissa into place
+        __m128 subnorm1 = _mm_add_ps(absf, _mm_castsi128_ps(c_subnorm_magic));
+        __m128i subnorm2 = _mm_sub_epi32(_mm_castps_si128(subnorm1), c_subnorm_magic);
+
+        // Normal results: rebias the exponent and round, ties to even
+        __m128i mantodd = _mm_srai_epi32(_mm_slli_epi32(absf_int, 31 - 13), 31);
+        __m128i round = _mm_sub_epi32(_mm_add_epi32(absf_int, c_normal_bias), mantodd);
+        __m128i normal = _mm_srli_epi32(round, 13);
+
+        __m128i nonspecial = _mm_or_si128(_mm_and_si128(subnorm2, b_issub), _mm_andnot_si128(b_issub, normal));
+        __m128i joined = _mm_or_si128(_mm_and_si128(nonspecial, b_isregular), _mm_andnot_si128(b_isregular, inf_or_nan));
+
+        // Arithmetic shift keeps negative results in int16 range for _mm_packs_epi32
+        return _mm_or_si128(joined, _mm_srai_epi32(_mm_castps_si128(justsign), 16));
+    }
+
+    CPU_TARGET("sse2")
+    size_t fromFloatSSE2(const float* src, glm::uint16* dst, size_t count) {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m128i lo = fromFloatSSE2x4(_mm_loadu_ps(src + i));
+            __m128i hi = fromFloatSSE2x4(_mm_loadu_ps(src + i + 4));
+            _mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(lo, hi));
+        }
+        return i;
+    }
+#endif
+}
+
+glm::uint16 Half::fromFloat(float value) {
+    uint32_t x;
+    std::memcpy(&x, &value, sizeof(x));
+
+    uint32_t sign = x & 0x80000000u;
+    x ^= sign;
+
+    uint32_t half;
+    if (x >= 0x47800000u) {
+        // Inf or NaN
+        half = x > 0x7f800000u ? 0x7e00 : 0x7c00;
+    }
+    else if (x < 0x38800000u) {
+        // Subnormal or zero, the FP adder does the rounding
+        const uint32_t magicBits = ((127 - 15) + (23 - 10) + 1) << 23;
+        float magic, f;
+        std::memcpy(&magic, &magicBits, sizeof(magic));
+        std::memcpy(&f, &x, sizeof(f));
+        f += magic;
+        std::memcpy(&half, &f, sizeof(half));
+        half -= magicBits;
+    }
+    else {
+        uint32_t mantOdd = (x >> 13) & 1;
+        x += ((uint32_t)(15 - 127) << 23) + 0xfff;
+        x += mantOdd;
+        half = x >> 13;
+    }
+    return (glm::uint16)(half | (sign >> 16));
+}
+
+void Half::fromFloat(const float* src, glm::uint16* dst, size_t count) {
+    size_t i = 0;
+#ifdef CPU_X86
+    i = CPUFeatures::hasF16C() ? fromFloatF16C(src, dst, count) : fromFloatSSE2(src, dst, count);
+#endif
+    for (; i < count; i++)
+        dst[i] = fromFloat(src[i]);
+}
+
+void Half::storeFace(gli::texture_cube& cubemap, size_t face, size_t level, const float* data) {
+    GLI_ASSERT(cubemap.format() == gli::FORMAT_RGB16_SFLOAT_PACK16);
+
+    gli::texture_cube::extent_type extent = cubemap.extent(level);
+    fromFloat(data, cubemap.data<glm::uint16>(0, face, level), 3 * (size_t)extent.x * extent.y);
+}
@@ -0,0 +1,23 @@
+#ifndef __XGP_HALF_H__
+#define __XGP_HALF_H__
+
+#include <glm/glm.hpp>
+#include <gli/gli.hpp>
+
+#include <cstddef>
+
+namespace Half {
+	// Converts count floats to half floats, rounding to nearest even. Uses F16C when
+	// the CPU supports it, SSE2 otherwise, and a scalar loop off x86.
+	void fromFloat(const float* src, glm::uint16* dst, size_t count);
+
+	// Same conversion as fromFloat, without SIMD
+	glm::uint16 fromFloat(float value);
+
+	// Fills a whole face/level of an RGB16F cubemap from tightly packed RGB floats,
+	// instead of going through texture_cube::store() once per texel.
+	// data must hold 3 * extent(level).x * extent(level).y floats.
+	void storeFace(gli::texture_cube& cubemap, size_t face, size_t level, const float* data);
+}
+
+#endif
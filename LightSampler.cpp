@@ -0,0 +1,143 @@
+#include "LightSampler.h"
+
+#include <CPUBaker.h>
+
+#include <algorithm>
+#include <cmath>
+
+static const float PI = 3.14159265359f;
+
+namespace {
+    float radicalInverse(unsigned int bits) {
+        bits = (bits << 16u) | (bits >> 16u);
+        bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+        bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+        bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+        bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+        return (float)bits * 2.3283064365386963e-10f; // / 0x100000000
+    }
+
+    // Base 3 Halton sequence, the third dimension of the light samples
+    float radicalInverse3(unsigned int i) {
+        float result = 0.0f;
+        float scale = 1.0f / 3.0f;
+        for (; i > 0; i /= 3, scale /= 3.0f)
+            result += (float)(i % 3) * scale;
+        return result;
+    }
+
+    float luminance(const float* rgb) {
+        return 0.2126f * rgb[0] + 0.7152f * rgb[1] + 0.0722f * rgb[2];
+    }
+
+    // Scale of a direction once stretched to reach its cube face, |dir| / max(|dir.x|, |dir.y|, |dir.z|)
+    float faceDistance(const glm::vec3& dir) {
+        glm::vec3 a = glm::abs(dir);
+        return glm::length(dir) / std::max(a.x, std::max(a.y, a.z));
+    }
+}
+
+LightSampler::LightSampler(const float* rgb, unsigned int size)
+    : _size(size) {
+    size_t texels = 6 * (size_t)size * size;
+
+    // Luminance times the solid angle of the texel, dA / r^3 at its center
+    _cdf.resize(texels);
+    double totalWeight = 0.0;
+    for (unsigned int face = 0; face < 6; face++) {
+        for (unsigned int y = 0; y < size; y++) {
+            for (unsigned int x = 0; x < size; x++) {
+                size_t i = ((size_t)face * size + y) * size + x;
+                float r = glm::length(CPUCubemap::direction(face, (x + 0.5f) / size, (y + 0.5f) / size));
+                // Also discards NaNs
+                float l = luminance(rgb + 3 * i);
+                totalWeight += l > 0.0f ? (double)l / ((double)r * r * r) : 0.0;
+                _cdf[i] = totalWeight;
+            }
+        }
+    }
+    if (totalWeight <= 0.0) {
+        _cdf.clear();
+        return;
+    }
+
+    _map.resize(texels);
+    double areaScale = (double)size * size / 4.0;
+    double previous = 0.0;
+    for (size_t i = 0; i < texels; i++) {
+        double probability = (_cdf[i] - previous) / totalWeight;
+        previous = _cdf[i];
+        _cdf[i] /= totalWeight;
+        _map[i] = glm::vec4(rgb[3 * i], rgb[3 * i + 1], rgb[3 * i + 2], (float)(probability * areaScale));
+    }
+}
+
+unsigned int LightSampler::level(unsigned int envRes) {
+    unsigned int level = 0;
+    while ((envRes >> level) > LIGHT_SAMPLER_RES)
+        level++;
+    return level;
+}
+
+unsigned int LightSampler::size() const {
+    return _size;
+}
+
+bool LightSampler::empty() const {
+    return _map.empty();
+}
+
+std::vector<glm::vec4> LightSampler::samples(unsigned int count) const {
+    std::vector<glm::vec4> samples;
+    if (empty())
+        return samples;
+
+    unsigned int faceTexels = _size * _size;
+    samples.reserve(count);
+    for (unsigned int i = 0; i < count; i++) {
+        double u = ((double)i + 0.5) / (double)count;
+        size_t texel = std::min((size_t)(std::upper_bound(_cdf.begin(), _cdf.end(), u) - _cdf.begin()), _cdf.size() - 1);
+
+        // Offset by one so that no sample lies on the edge of its texel, where the
+        // nearest texel lookups of evaluate() and the shaders could pick its neighbour
+        unsigned int face = (unsigned int)(texel / faceTexels);
+        unsigned int x = (unsigned int)(texel % _size);
+        unsigned int y = (unsigned int)((texel % faceTexels) / _size);
+        glm::vec3 dir = CPUCubemap::direction(face, (x + radicalInverse(i + 1)) / _size, (y + radicalInverse3(i + 1)) / _size);
+
+        float r = glm::length(dir);
+        samples.push_back(glm::vec4(dir / r, _map[texel].w * r * r * r));
+    }
+    return samples;
+}
+
+glm::vec4 LightSampler::evaluate(const glm::vec3& dir) const {
+    if (empty())
+        return glm::vec4(0.0f);
+
+    float u, v;
+    unsigned int face = CPUCubemap::faceCoords(dir, u, v);
+    unsigned int x = std::min((unsigned int)std::max(u * _size, 0.0f), _size - 1);
+    unsigned int y = std::min((unsigned int)std::max(v * _size, 0.0f), _size - 1);
+    glm::vec4 texel = _map[((size_t)face * _size + y) * _size + x];
+
+    float r = faceDistance(dir);
+    return glm::vec4(glm::vec3(texel), texel.w * r * r * r);
+}
+
+const std::vector<glm::vec4>& LightSampler::map() const {
+    return _map;
+}
+
+std::vector<glm::vec4> LightSampler::cosineSamples(unsigned int count) {
+    std::vector<glm::vec4> samples;
+    samples.reserve(count);
+    for (unsigned int i = 0; i < count; i++) {
+        float phi = 2.0f * PI * (float)i / (float)count;
+        float xi = radicalInverse(i);
+        float cosTheta = std::sqrt(1.0f - xi);
+        float sinTheta = std::sqrt(xi);
+        samples.push_back(glm::vec4(std::cos(phi) * sinTheta, std::sin(phi) * sinTheta, cosTheta, cosTheta / PI));
+    }
+    return samples;
+}
@@ -0,0 +1,58 @@
+#ifndef __XGP_LIGHTSAMPLER_H__
+#define __XGP_LIGHTSAMPLER_H__
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Largest environment face the luminance distribution is built from: fine enough to
+// isolate a sun, small enough to rebuild for every image
+#define LIGHT_SAMPLER_RES 256u
+
+// Luminance importance sampling of an environment cubemap, for sun dominated images
+// that BRDF sampling alone rarely hits. Every texel of one environment level is picked
+// with a probability proportional to its luminance times its solid angle, then a
+// direction is drawn uniformly over its face area.
+//
+// The samples don't depend on the texel being baked, the whole map shares one set. Its
+// error is then the same for every texel and only stratification keeps it low: the
+// texels are drawn by inverting their CDF at evenly spaced points, which gives each one
+// its expected number of samples give or take one.
+//
+// The importance sampled passes read the environment through map(), at the resolution
+// of the distribution and without filtering, so that both strategies of the multiple
+// importance sampling integrate the same piecewise constant function.
+class LightSampler {
+public:
+	// rgb holds the six faces of the environment level, one after the other, as tightly packed RGB floats
+	LightSampler(const float* rgb, unsigned int size);
+
+	// Level of an environment map of size envRes the distribution is built from
+	static unsigned int level(unsigned int envRes);
+
+	unsigned int size() const;
+	// A black environment has nothing to sample
+	bool empty() const;
+
+	// Directions in xyz, normalized, and their solid angle pdf in w
+	std::vector<glm::vec4> samples(unsigned int count) const;
+	// Radiance of the texel holding dir (any length) in rgb, and the solid angle pdf of drawing dir in w
+	glm::vec4 evaluate(const glm::vec3& dir) const;
+
+	// Every texel, face after face: the radiance in rgb and in w the pdf per unit of face
+	// area, in [-1, 1] face coordinates. The solid angle pdf of dir is this density times
+	// |dir|^3 once dir is scaled to reach the face.
+	const std::vector<glm::vec4>& map() const;
+
+	// Cosine weighted Hammersley directions of the tangent hemisphere, z is NdotL and w their pdf:
+	// the BRDF samples the importance sampled irradiance pass combines with the light samples
+	static std::vector<glm::vec4> cosineSamples(unsigned int count);
+
+private:
+	unsigned int _size;
+	std::vector<glm::vec4> _map;
+	// Running sum of the texel probabilities
+	std::vector<double> _cdf;
+};
+
+#endif
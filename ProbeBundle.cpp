@@ -0,0 +1,99 @@
+#include "ProbeBundle.h"
+
+#include <cstring>
+#include <fstream>
+
+namespace {
+    uint64_t alignUp(uint64_t offset) {
+        return (offset + BUNDLE_ALIGNMENT - 1) / BUNDLE_ALIGNMENT * BUNDLE_ALIGNMENT;
+    }
+}
+
+void ProbeBundle::add(BundleKind kind, const gli::texture& texture, const std::vector<float>& ranges) {
+    GLI_ASSERT(texture.layers() == 1 && (ranges.empty() || ranges.size() == texture.levels()));
+    _products.push_back(Product{ kind, texture, ranges });
+}
+
+void ProbeBundle::add(const SphericalHarmonics& sh) {
+    gli::texture2d coeffs(gli::FORMAT_RGB32_SFLOAT_PACK32, gli::extent2d(9, 1), 1);
+    for (unsigned int i = 0; i < 9; i++)
+        coeffs.store(gli::extent2d(i, 0), 0, sh[i]);
+    add(BundleKind::IrradianceSH, coeffs);
+}
+
+bool ProbeBundle::save(const std::string& filepath) const {
+    BundleHeader header = {};
+    std::memcpy(header.magic, BUNDLE_MAGIC, sizeof(header.magic));
+    header.version = BUNDLE_VERSION;
+    header.alignment = BUNDLE_ALIGNMENT;
+    header.entryCount = (uint32_t)_products.size();
+    for (const Product& product : _products)
+        header.subresourceCount += (uint32_t)(product.texture.faces() * product.texture.levels());
+
+    // Lay the payloads out after the tables
+    gli::gl GL(gli::gl::PROFILE_GL33);
+    gli::dx DX;
+    std::vector<BundleEntry> entries;
+    std::vector<BundleSubresource> subresources;
+    uint64_t offset = alignUp(sizeof(BundleHeader) + header.entryCount * sizeof(BundleEntry) + header.subresourceCount * sizeof(BundleSubresource));
+    for (const Product& product : _products) {
+        const gli::texture& texture = product.texture;
+        gli::gl::format glFormat = GL.translate(texture.format(), texture.swizzles());
+        bool compressed = gli::is_compressed(texture.format());
+
+        BundleEntry entry = {};
+        entry.kind = product.kind;
+        entry.glInternalFormat = (uint32_t)glFormat.Internal;
+        entry.glFormat = compressed ? 0 : (uint32_t)glFormat.External;
+        entry.glType = compressed ? 0 : (uint32_t)glFormat.Type;
+        // The GLI1 FourCC marks the formats D3D lacks, whose DXGI values are gli's own
+        const gli::dx::format& dxFormat = DX.translate(texture.format());
+        entry.dxgiFormat = dxFormat.D3DFormat == gli::dx::D3DFMT_GLI1 ? 0 : (uint32_t)dxFormat.DXGIFormat.DDS;
+        entry.width = (uint32_t)texture.extent().x;
+        entry.height = (uint32_t)texture.extent().y;
+        entry.faces = (uint32_t)texture.faces();
+        entry.levels = (uint32_t)texture.levels();
+        entry.firstSubresource = (uint32_t)subresources.size();
+        entry.offset = offset;
+        entry.size = texture.size();
+        entries.push_back(entry);
+
+        // gli stores the faces one after the other, each with its whole mip chain
+        uint64_t subresourceOffset = offset;
+        for (uint32_t face = 0; face < entry.faces; face++) {
+            for (uint32_t level = 0; level < entry.levels; level++) {
+                BundleSubresource subresource = {};
+                subresource.offset = subresourceOffset;
+                subresource.size = texture.size(level);
+                subresource.face = face;
+                subresource.level = level;
+                subresource.range = product.ranges.empty() ? 0.0f : product.ranges[level];
+                subresources.push_back(subresource);
+                subresourceOffset += subresource.size;
+            }
+        }
+        offset = alignUp(offset + entry.size);
+    }
+    header.fileSize = offset;
+
+    std::ofstream file(filepath, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    if (file.fail())
+        return false;
+
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)entries.data(), entries.size() * sizeof(BundleEntry));
+    file.write((const char*)subresources.data(), subresources.size() * sizeof(BundleSubresource));
+
+    // Zero padding up to every payload and to the end of the file
+    std::vector<char> padding(BUNDLE_ALIGNMENT, 0);
+    uint64_t position = sizeof(header) + entries.size() * sizeof(BundleEntry) + subresources.size() * sizeof(BundleSubresource);
+    for (size_t i = 0; i <= _products.size(); i++) {
+        uint64_t next = i < _products.size() ? entries[i].offset : header.fileSize;
+        file.write(padding.data(), (std::streamsize)(next - position));
+        if (i < _products.size()) {
+            file.write((const char*)_products[i].texture.data(), (std::streamsize)entries[i].size);
+            position = next + entries[i].size;
+        }
+    }
+    return !file.fail();
+}
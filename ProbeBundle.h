@@ -0,0 +1,88 @@
+#ifndef __XGP_PROBEBUNDLE_H__
+#define __XGP_PROBEBUNDLE_H__
+
+#include <gli/gli.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <SphericalHarmonics.h>
+
+// Single file holding every product of an image, laid out so that a runtime can map it
+// and hand pointers straight to the graphics API, without parsing nor copying:
+//  - a BundleHeader at offset 0
+//  - entryCount BundleEntry records, one per product
+//  - subresourceCount BundleSubresource records, the faces and levels of every entry
+//  - the payloads, each starting on a multiple of alignment
+// A payload is stored like in a DDS file, face after face with all their levels tightly
+// packed: uncompressed levels upload with GL_UNPACK_ALIGNMENT 1. All fields are little endian.
+
+#define BUNDLE_MAGIC "PBRPROBE"
+#define BUNDLE_VERSION 1
+#define BUNDLE_ALIGNMENT 4096
+
+enum class BundleKind : uint32_t {
+	Environment,
+	Irradiance,
+	Prefilter,
+	IrradianceSH,   // the 9 coefficients of irradiance_sh.txt as a 9x1 RGB32F image
+	BRDFLut
+};
+
+struct BundleHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t alignment;
+	uint32_t entryCount;
+	uint32_t subresourceCount;
+	uint64_t fileSize;
+};
+
+struct BundleEntry {
+	BundleKind kind;
+	// glFormat and glType are 0 for compressed formats, dxgiFormat is 0 (DXGI_FORMAT_UNKNOWN)
+	// for the formats D3D lacks, such as RGB16F
+	uint32_t glInternalFormat;
+	uint32_t glFormat;
+	uint32_t glType;
+	uint32_t dxgiFormat;
+	uint32_t width;
+	uint32_t height;
+	uint32_t faces;             // 6 for cubemaps, 1 otherwise
+	uint32_t levels;
+	uint32_t firstSubresource;  // faces * levels records, face after face
+	uint64_t offset;            // from the start of the file
+	uint64_t size;
+};
+
+struct BundleSubresource {
+	uint64_t offset;            // from the start of the file
+	uint64_t size;
+	uint32_t face;
+	uint32_t level;
+	float range;                // of RGBM and RGBD levels, 0 for other formats
+	uint32_t reserved;
+};
+
+static_assert(sizeof(BundleHeader) == 32 && sizeof(BundleEntry) == 56 && sizeof(BundleSubresource) == 32, "Bundle records must not be padded");
+
+class ProbeBundle {
+public:
+	// The texture storage is shared, not copied, until save(). ranges holds one range per
+	// level for RGBM and RGBD textures and is empty otherwise.
+	void add(BundleKind kind, const gli::texture& texture, const std::vector<float>& ranges = std::vector<float>());
+	void add(const SphericalHarmonics& sh);
+
+	bool save(const std::string& filepath) const;
+
+private:
+	struct Product {
+		BundleKind kind;
+		gli::texture texture;
+		std::vector<float> ranges;
+	};
+	std::vector<Product> _products;
+};
+
+#endif
@@ -0,0 +1,137 @@
+#include "RGB9E5.h"
+
+#include <CPUFeatures.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include <glm/gtc/packing.hpp>
+
+// Largest encodable value, 511/512 * 2^16
+static const float MAX_VALUE = 65408.0f;
+// Smallest value with a non zero exponent, 2^-16. Clamping the largest channel to it keeps
+// the exponent at 0 or above without changing the encoding.
+static const uint32_t MIN_EXPONENT_BITS = 111u << 23;
+
+namespace {
+    uint32_t floatBits(float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    // 2^exponent for exponent in the normal range
+    float power(int exponent) {
+        uint32_t bits = (uint32_t)(exponent + 127) << 23;
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+#ifdef CPU_X86
+    // Converts 4 half floats zero extended to 32 bits. Negative values and NaNs give 0,
+    // infinities give 2^16, which the encoder clamps like any other large value.
+    CPU_TARGET("sse2")
+    __m128 halfToFloatSSE2(__m128i h) {
+        // Half float bits shifted to the place of the float ones, the scale fixes the exponent bias
+        // and normalizes subnormals
+        __m128 f = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(h, 13)), _mm_castsi128_ps(_mm_set1_epi32((127 + 127 - 15) << 23)));
+        // Only positive values up to infinity are kept, the sign bit makes the others larger
+        __m128i keep = _mm_cmplt_epi32(h, _mm_set1_epi32(0x7c01));
+        return _mm_and_ps(f, _mm_castsi128_ps(keep));
+    }
+
+    // Same steps as RGB9E5::encode(float, float, float), 4 texels at a time
+    CPU_TARGET("sse2")
+    __m128i encodeSSE2x4(__m128 r, __m128 g, __m128 b) {
+        const __m128 maxValue = _mm_set1_ps(MAX_VALUE);
+        const __m128 half = _mm_set1_ps(0.5f);
+        r = _mm_min_ps(r, maxValue);
+        g = _mm_min_ps(g, maxValue);
+        b = _mm_min_ps(b, maxValue);
+
+        __m128 maxRGB = _mm_max_ps(r, _mm_max_ps(g, b));
+        __m128i exponentBits = _mm_srli_epi32(_mm_castps_si128(_mm_max_ps(maxRGB, _mm_castsi128_ps(_mm_set1_epi32((int)MIN_EXPONENT_BITS)))), 23);
+        __m128i exponent = _mm_sub_epi32(exponentBits, _mm_set1_epi32(111));
+        __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_sub_epi32(_mm_set1_epi32(24 + 127), exponent), 23));
+
+        // Rounding the largest channel up to 512 needs the next exponent
+        __m128i maxMantissa = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(maxRGB, scale), half));
+        __m128i overflow = _mm_cmpeq_epi32(maxMantissa, _mm_set1_epi32(512));
+        exponent = _mm_sub_epi32(exponent, overflow);
+        scale = _mm_castsi128_ps(_mm_sub_epi32(_mm_castps_si128(scale), _mm_and_si128(overflow, _mm_set1_epi32(1 << 23))));
+
+        __m128i rm = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(r, scale), half));
+        __m128i gm = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(g, scale), half));
+        __m128i bm = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(b, scale), half));
+        return _mm_or_si128(_mm_or_si128(rm, _mm_slli_epi32(gm, 9)), _mm_or_si128(_mm_slli_epi32(bm, 18), _mm_slli_epi32(exponent, 27)));
+    }
+
+    // Returns how many texels were converted
+    CPU_TARGET("sse2")
+    size_t encodeSSE2(const glm::uint16* rgb, glm::uint32* dst, size_t count) {
+        const __m128i zero = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            // r0 g0 b0 r1 | g1 b1 r2 g2 | b2 r3 g3 b3
+            __m128i first = _mm_loadu_si128((const __m128i*)(rgb + 3 * i));
+            __m128i last = _mm_loadl_epi64((const __m128i*)(rgb + 3 * i + 8));
+            __m128 a = halfToFloatSSE2(_mm_unpacklo_epi16(first, zero));
+            __m128 b = halfToFloatSSE2(_mm_unpackhi_epi16(first, zero));
+            __m128 c = halfToFloatSSE2(_mm_unpacklo_epi16(last, zero));
+
+            __m128 red = _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+            __m128 green = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 blue = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 3, 0)), _MM_SHUFFLE(1, 0, 2, 0));
+            _mm_storeu_si128((__m128i*)(dst + i), encodeSSE2x4(red, green, blue));
+        }
+        return i;
+    }
+#endif
+}
+
+glm::uint32 RGB9E5::encode(float r, float g, float b) {
+    // Also discards NaNs
+    r = r > 0.0f ? std::min(r, MAX_VALUE) : 0.0f;
+    g = g > 0.0f ? std::min(g, MAX_VALUE) : 0.0f;
+    b = b > 0.0f ? std::min(b, MAX_VALUE) : 0.0f;
+
+    // floor(log2(maxRGB)) + 16, the exponent that keeps maxRGB under 512 once scaled
+    float maxRGB = std::max(r, std::max(g, b));
+    int exponent = (int)(std::max(floatBits(maxRGB), MIN_EXPONENT_BITS) >> 23) - 111;
+    float scale = power(24 - exponent);
+
+    // Rounding the largest channel up to 512 needs the next exponent
+    if ((uint32_t)(maxRGB * scale + 0.5f) == 512) {
+        exponent++;
+        scale *= 0.5f;
+    }
+
+    uint32_t rm = (uint32_t)(r * scale + 0.5f);
+    uint32_t gm = (uint32_t)(g * scale + 0.5f);
+    uint32_t bm = (uint32_t)(b * scale + 0.5f);
+    return rm | (gm << 9) | (bm << 18) | ((uint32_t)exponent << 27);
+}
+
+void RGB9E5::encode(const glm::uint16* rgb, glm::uint32* dst, size_t count) {
+    size_t i = 0;
+#ifdef CPU_X86
+    i = encodeSSE2(rgb, dst, count);
+#endif
+    for (; i < count; i++)
+        dst[i] = encode(glm::unpackHalf1x16(rgb[3 * i]), glm::unpackHalf1x16(rgb[3 * i + 1]), glm::unpackHalf1x16(rgb[3 * i + 2]));
+}
+
+gli::texture_cube RGB9E5::encode(const gli::texture_cube& cubemap) {
+    GLI_ASSERT(cubemap.format() == gli::FORMAT_RGB16_SFLOAT_PACK16);
+    gli::texture_cube encoded(gli::FORMAT_RGB9E5_UFLOAT_PACK32, cubemap.extent(), cubemap.levels());
+
+    for (size_t face = 0; face < 6; face++) {
+        for (size_t level = 0; level < cubemap.levels(); level++) {
+            gli::texture_cube::extent_type extent = cubemap.extent(level);
+            encode(cubemap.data<glm::uint16>(0, face, level), encoded.data<glm::uint32>(0, face, level), (size_t)extent.x * extent.y);
+        }
+    }
+    return encoded;
+}
@@ -0,0 +1,24 @@
+#ifndef __XGP_RGB9E5_H__
+#define __XGP_RGB9E5_H__
+
+#include <glm/glm.hpp>
+#include <gli/gli.hpp>
+
+#include <cstddef>
+
+// Shared exponent output: 9 bit mantissas for R, G and B and one 5 bit exponent in
+// 4 aligned bytes per texel, two thirds of RGB16F and without block artefacts.
+// The exponent has the same bias as half floats, so the largest value is 65408.
+namespace RGB9E5 {
+	// Encodes every face and level of an RGB16F cubemap into a FORMAT_RGB9E5_UFLOAT_PACK32 one
+	gli::texture_cube encode(const gli::texture_cube& cubemap);
+
+	// Packs count RGB half float texels, 4 at a time with SSE2 on x86. Negative values
+	// and NaNs become 0, larger values and infinities are clamped to 65408.
+	void encode(const glm::uint16* rgb, glm::uint32* dst, size_t count);
+
+	// Packs one texel, rounding like the reference encoder of EXT_texture_shared_exponent
+	glm::uint32 encode(float r, float g, float b);
+}
+
+#endif
@@ -0,0 +1,203 @@
+#include "RGBM.h"
+
+#include <BC3.h>
+#include <Utils.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#include <glm/gtc/packing.hpp>
+
+// Texels of a level the range is fitted to, and how many quarter stops below the
+// brightest channel are tried
+#define FIT_SAMPLES 4096
+#define FIT_STEPS 48
+
+// Largest finite half float, infinities are clamped to it
+static const float HALF_MAX = 65504.0f;
+
+namespace {
+    glm::vec3 loadTexel(const glm::uint16* rgb) {
+        glm::vec3 color;
+        for (int c = 0; c < 3; c++) {
+            float value = glm::unpackHalf1x16(rgb[c]);
+            // Also discards NaNs
+            color[c] = value > 0.0f ? std::min(value, HALF_MAX) : 0.0f;
+        }
+        return color;
+    }
+
+    // RGBM stores the smallest multiplier that reaches the brightest channel, RGBD the
+    // largest divider that still does
+    unsigned int alpha(const glm::vec3& color, float range, OutputFormat format) {
+        float maxRGB = std::max(color.r, std::max(color.g, color.b));
+        if (format == OutputFormat::RGBM)
+            return (unsigned int)std::min(std::max(std::ceil(maxRGB / range * 255.0f), 1.0f), 255.0f);
+        if (maxRGB <= 0.0f)
+            return 255;
+        return (unsigned int)std::min(std::max(std::floor(range / maxRGB), 1.0f), 255.0f);
+    }
+
+    // Colour bytes of color once decoded with the alpha byte a
+    glm::u8vec3 rgb(const glm::vec3& color, unsigned int a, float range, OutputFormat format) {
+        float scale = format == OutputFormat::RGBM ? 255.0f * 255.0f / ((float)a * range) : 255.0f * (float)a / range;
+        glm::u8vec3 bytes;
+        for (int c = 0; c < 3; c++)
+            bytes[c] = (glm::uint8)std::min(color[c] * scale + 0.5f, 255.0f);
+        return bytes;
+    }
+
+    // Colour bytes rounded to the precision of BC1 endpoints, which bounds the precision of
+    // dark BC3 blocks well enough to fit their range
+    glm::u8vec3 roundTo565(const glm::u8vec3& bytes) {
+        unsigned int r = (bytes.r * 31 + 127) / 255, g = (bytes.g * 63 + 127) / 255, b = (bytes.b * 31 + 127) / 255;
+        return glm::u8vec3((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2));
+    }
+}
+
+glm::u8vec4 RGBM::encode(const glm::vec3& color, float range, OutputFormat format) {
+    unsigned int a = alpha(color, range, format);
+    return glm::u8vec4(rgb(color, a, range, format), (glm::uint8)a);
+}
+
+glm::vec3 RGBM::decode(const glm::u8vec4& texel, float range, OutputFormat format) {
+    glm::vec3 color = glm::vec3(texel.r, texel.g, texel.b) / 255.0f;
+    if (format == OutputFormat::RGBM)
+        return color * ((float)texel.a / 255.0f * range);
+    return color * (range / (float)std::max(texel.a, (glm::uint8)1));
+}
+
+float RGBM::fitRange(const gli::texture_cube& cubemap, size_t level, OutputFormat format, bool bc3) {
+    gli::texture_cube::extent_type extent = cubemap.extent(level);
+    size_t faceTexels = (size_t)extent.x * extent.y;
+    size_t stride = std::max(6 * faceTexels / FIT_SAMPLES, (size_t)1);
+
+    // Positive half floats sort like their bits, up to infinity
+    glm::uint16 maxBits = 0;
+    double sum = 0.0;
+    std::vector<glm::vec3> samples;
+    for (size_t face = 0; face < 6; face++) {
+        const glm::uint16* data = cubemap.data<glm::uint16>(0, face, level);
+        for (size_t i = 0; i < 3 * faceTexels; i++) {
+            if (data[i] <= 0x7C00)
+                maxBits = std::max(maxBits, data[i]);
+        }
+        for (size_t i = (stride - face * faceTexels % stride) % stride; i < faceTexels; i += stride) {
+            samples.push_back(loadTexel(data + 3 * i));
+            sum += samples.back().r + samples.back().g + samples.back().b;
+        }
+    }
+    float maxValue = std::min(glm::unpackHalf1x16(maxBits), HALF_MAX);
+    if (maxValue <= 0.0f)
+        return 1.0f;
+
+    // Errors on values below 1/256 of the mean of the level don't matter
+    float epsilon = std::max((float)(sum / (3.0 * samples.size())) / 256.0f, maxValue * 1e-6f);
+    float best = maxValue;
+    double bestError = DBL_MAX;
+    for (int step = 0; step <= FIT_STEPS; step++) {
+        float range = maxValue * std::exp2(-(float)step / 4.0f);
+        double error = 0.0;
+        for (const glm::vec3& color : samples) {
+            glm::u8vec4 texel = encode(color, range, format);
+            if (bc3)
+                texel = glm::u8vec4(roundTo565(glm::u8vec3(texel)), texel.a);
+            glm::vec3 decoded = decode(texel, range, format);
+            for (int c = 0; c < 3; c++) {
+                float e = std::log((decoded[c] + epsilon) / (color[c] + epsilon));
+                error += e * e;
+            }
+        }
+        if (error < bestError) {
+            bestError = error;
+            best = range;
+        }
+    }
+    return best;
+}
+
+gli::texture_cube RGBM::encode(const gli::texture_cube& cubemap, OutputFormat format, bool bc3, std::vector<float>& ranges) {
+    GLI_ASSERT(cubemap.format() == gli::FORMAT_RGB16_SFLOAT_PACK16);
+    GLI_ASSERT(format == OutputFormat::RGBM || format == OutputFormat::RGBD);
+    gli::texture_cube encoded(bc3 ? gli::FORMAT_RGBA_DXT5_UNORM_BLOCK16 : gli::FORMAT_RGBA8_UNORM_PACK8, cubemap.extent(), cubemap.levels());
+
+    ranges.resize(cubemap.levels());
+    for (size_t level = 0; level < cubemap.levels(); level++)
+        ranges[level] = fitRange(cubemap, level, format, bc3);
+
+    for (size_t face = 0; face < 6; face++) {
+        for (size_t level = 0; level < cubemap.levels(); level++) {
+            encodeFace(cubemap.data<glm::uint16>(0, face, level), (unsigned int)cubemap.extent(level).x, ranges[level],
+                       format, bc3, encoded.data<unsigned char>(0, face, level));
+        }
+    }
+    return encoded;
+}
+
+void RGBM::encodeFace(const glm::uint16* src, unsigned int size, float range, OutputFormat format, bool bc3, unsigned char* dst) {
+    GLI_ASSERT(format == OutputFormat::RGBM || format == OutputFormat::RGBD);
+
+    // One job per row of 4x4 blocks
+    unsigned int blocksX = (size + 3) / 4;
+    Utils::parallelFor(blocksX, [&](unsigned int by) {
+        unsigned int row = 4 * by;
+        if (!bc3) {
+            for (unsigned int y = row; y < std::min(row + 4, size); y++) {
+                for (unsigned int x = 0; x < size; x++) {
+                    size_t i = (size_t)y * size + x;
+                    glm::u8vec4 texel = encode(loadTexel(src + 3 * i), range, format);
+                    std::memcpy(dst + 4 * i, &texel, 4);
+                }
+            }
+            return;
+        }
+
+        for (unsigned int bx = 0; bx < blocksX; bx++) {
+            glm::vec3 colors[16];
+            glm::uint8 alphas[16], decoded[16];
+            // Levels smaller than a block repeat their edge texels
+            for (unsigned int i = 0; i < 16; i++) {
+                unsigned int x = std::min(4 * bx + i % 4, size - 1);
+                unsigned int y = std::min(row + i / 4, size - 1);
+                colors[i] = loadTexel(src + 3 * ((size_t)y * size + x));
+                alphas[i] = (glm::uint8)alpha(colors[i], range, format);
+            }
+
+            // The colours are scaled by the alpha the decoder will see, not the exact one
+            unsigned char* block = dst + 16 * ((size_t)by * blocksX + bx);
+            BC3::encodeAlpha(alphas, block, decoded);
+            glm::u8vec4 texels[16];
+            for (unsigned int i = 0; i < 16; i++)
+                texels[i] = glm::u8vec4(rgb(colors[i], decoded[i], range, format), decoded[i]);
+            BC3::encodeColor(texels, block + 8);
+        }
+    });
+}
+
+bool RGBM::saveRanges(const std::vector<float>& ranges, const std::string& filepath) {
+    std::ofstream file(filepath, std::ios_base::out | std::ios_base::trunc);
+    if (file.fail())
+        return false;
+
+    file.precision(9);
+    for (float range : ranges)
+        file << range << "\n";
+    return !file.fail();
+}
+
+bool RGBM::saveRanges(const std::vector<std::vector<float>>& layers, const std::string& filepath) {
+    std::ofstream file(filepath, std::ios_base::out | std::ios_base::trunc);
+    if (file.fail())
+        return false;
+
+    file.precision(9);
+    for (const std::vector<float>& ranges : layers) {
+        for (size_t level = 0; level < ranges.size(); level++)
+            file << (level > 0 ? " " : "") << ranges[level];
+        file << "\n";
+    }
+    return !file.fail();
+}
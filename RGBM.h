@@ -0,0 +1,41 @@
+#ifndef __XGP_RGBM_H__
+#define __XGP_RGBM_H__
+
+#include <glm/glm.hpp>
+#include <gli/gli.hpp>
+
+#include <string>
+#include <vector>
+
+#include <Bake.h>
+
+// RGBM and RGBD encodings of the baked cubemaps into 8 bit RGBA, for targets without half
+// float textures. Every level gets its own range, fitted to its texels by fitRange():
+//  - RGBM decodes as rgb * a * range, most precise close to the range
+//  - RGBD decodes as rgb * range / (255 * a), most precise far below it
+// Values above the range are clipped per channel, negative values and NaNs become 0.
+namespace RGBM {
+	// Encodes every face and level of an RGB16F cubemap into FORMAT_RGBA8_UNORM_PACK8, or
+	// FORMAT_RGBA_DXT5_UNORM_BLOCK16 with bc3, over all hardware threads. format is
+	// OutputFormat::RGBM or OutputFormat::RGBD, ranges receives the range of each level.
+	gli::texture_cube encode(const gli::texture_cube& cubemap, OutputFormat format, bool bc3, std::vector<float>& ranges);
+
+	// Range of one level minimizing the squared log error of up to 4096 of its texels once
+	// encoded, among ranges a quarter stop apart below its brightest channel. With bc3 the
+	// colours are rounded to 565 like the endpoints of the blocks.
+	float fitRange(const gli::texture_cube& cubemap, size_t level, OutputFormat format, bool bc3);
+
+	// Encodes one size x size face of RGB half floats with the range of its level, into
+	// 4 bytes per texel or, with bc3, BC3 blocks, the rows spread over all hardware threads
+	void encodeFace(const glm::uint16* src, unsigned int size, float range, OutputFormat format, bool bc3, unsigned char* dst);
+
+	glm::u8vec4 encode(const glm::vec3& color, float range, OutputFormat format);
+	glm::vec3 decode(const glm::u8vec4& texel, float range, OutputFormat format);
+
+	// Writes the ranges as text, one line per level from the first one
+	bool saveRanges(const std::vector<float>& ranges, const std::string& filepath);
+	// Writes the ranges of every layer of a cubemap array, one line of space separated levels per layer
+	bool saveRanges(const std::vector<std::vector<float>>& layers, const std::string& filepath);
+}
+
+#endif
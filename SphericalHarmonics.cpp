@@ -0,0 +1,116 @@
+#include "SphericalHarmonics.h"
+
+#include <CPUBaker.h>
+#include <Utils.h>
+
+#include <glm/gtc/packing.hpp>
+
+#include <cmath>
+#include <fstream>
+#include <vector>
+
+namespace {
+    // Integral of the solid angle from the face center to (x, y), x and y in [-1, 1]
+    double areaElement(double x, double y) {
+        return std::atan2(x * y, std::sqrt(x * x + y * y + 1.0));
+    }
+
+    // Projects the texels of one face, fetch(i) returning the RGB radiance of texel i
+    template <typename Fetch>
+    void projectFace(glm::vec3 coeffs[9], unsigned int face, unsigned int size, Fetch fetch) {
+        // One partial sum per row, reduced afterwards so the rows can be projected in parallel
+        std::vector<glm::dvec3> rows(size * 9, glm::dvec3(0.0));
+        double texelSize = 2.0 / size;
+
+        Utils::parallelFor(size, [&](unsigned int y) {
+            glm::dvec3* sum = &rows[y * 9];
+            double y0 = -1.0 + y * texelSize;
+            double y1 = y0 + texelSize;
+            for (unsigned int x = 0; x < size; x++) {
+                double x0 = -1.0 + x * texelSize;
+                double x1 = x0 + texelSize;
+                double solidAngle = areaElement(x0, y0) - areaElement(x0, y1) - areaElement(x1, y0) + areaElement(x1, y1);
+
+                glm::vec3 dir = glm::normalize(CPUCubemap::direction(face, (x + 0.5f) / size, (y + 0.5f) / size));
+                float Y[9];
+                SphericalHarmonics::basis(dir, Y);
+
+                glm::dvec3 radiance = glm::dvec3(fetch(y * size + x)) * solidAngle;
+                for (unsigned int i = 0; i < 9; i++)
+                    sum[i] += radiance * (double)Y[i];
+            }
+        });
+
+        for (unsigned int y = 0; y < size; y++) {
+            for (unsigned int i = 0; i < 9; i++)
+                coeffs[i] += glm::vec3(rows[y * 9 + i]);
+        }
+    }
+}
+
+SphericalHarmonics::SphericalHarmonics() {
+    for (glm::vec3& c : _coeffs)
+        c = glm::vec3(0.0f);
+}
+
+void SphericalHarmonics::basis(const glm::vec3& dir, float Y[9]) {
+    Y[0] = 0.282095f;
+    Y[1] = 0.488603f * dir.y;
+    Y[2] = 0.488603f * dir.z;
+    Y[3] = 0.488603f * dir.x;
+    Y[4] = 1.092548f * dir.x * dir.y;
+    Y[5] = 1.092548f * dir.y * dir.z;
+    Y[6] = 0.315392f * (3.0f * dir.z * dir.z - 1.0f);
+    Y[7] = 1.092548f * dir.x * dir.z;
+    Y[8] = 0.546274f * (dir.x * dir.x - dir.y * dir.y);
+}
+
+void SphericalHarmonics::addFace(unsigned int face, const float* data, unsigned int size) {
+    projectFace(_coeffs, face, size, [&](size_t i) {
+        return glm::vec3(data[i * 3], data[i * 3 + 1], data[i * 3 + 2]);
+    });
+}
+
+void SphericalHarmonics::addFace(unsigned int face, const glm::uint16* data, unsigned int size) {
+    projectFace(_coeffs, face, size, [&](size_t i) {
+        return glm::vec3(glm::unpackHalf1x16(data[i * 3]), glm::unpackHalf1x16(data[i * 3 + 1]), glm::unpackHalf1x16(data[i * 3 + 2]));
+    });
+}
+
+SphericalHarmonics SphericalHarmonics::irradiance() const {
+    // Clamped cosine lobe band factors (PI, 2PI/3, PI/4), divided by PI
+    const float band[9] = { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+
+    SphericalHarmonics result;
+    for (unsigned int i = 0; i < 9; i++)
+        result._coeffs[i] = _coeffs[i] * band[i];
+    return result;
+}
+
+glm::vec3 SphericalHarmonics::evaluate(const glm::vec3& dir) const {
+    float Y[9];
+    basis(dir, Y);
+
+    glm::vec3 result = glm::vec3(0.0f);
+    for (unsigned int i = 0; i < 9; i++)
+        result += _coeffs[i] * Y[i];
+    return glm::max(result, glm::vec3(0.0f));
+}
+
+const glm::vec3& SphericalHarmonics::operator[](unsigned int i) const {
+    return _coeffs[i];
+}
+
+bool SphericalHarmonics::save(const std::string& filepath) const {
+    std::ofstream file(filepath, std::ios_base::out | std::ios_base::trunc);
+    if (file.fail())
+        return false;
+    return save(file);
+}
+
+bool SphericalHarmonics::save(std::ostream& stream) const {
+    stream.precision(9);
+    for (const glm::vec3& c : _coeffs)
+        stream << c.r << " " << c.g << " " << c.b << "\n";
+    return !stream.fail();
+}
@@ -0,0 +1,37 @@
+#ifndef __XGP_SPHERICALHARMONICS_H__
+#define __XGP_SPHERICALHARMONICS_H__
+
+#include <glm/glm.hpp>
+
+#include <ostream>
+#include <string>
+
+// Order 2 (9 coefficients) RGB spherical harmonics
+class SphericalHarmonics {
+public:
+	SphericalHarmonics();
+
+	// Projects one RGB float cubemap face onto the basis, weighting every texel by its solid angle
+	void addFace(unsigned int face, const float* data, unsigned int size);
+	// Same as above for RGB half float data
+	void addFace(unsigned int face, const glm::uint16* data, unsigned int size);
+
+	// Convolves the projected radiance with the clamped cosine lobe. The result is
+	// scaled by 1/PI to match the output of irradiance.fs.
+	SphericalHarmonics irradiance() const;
+
+	glm::vec3 evaluate(const glm::vec3& dir) const;
+
+	const glm::vec3& operator[](unsigned int i) const;
+
+	// Writes the coefficients as text, one "r g b" line per coefficient
+	bool save(const std::string& filepath) const;
+	bool save(std::ostream& stream) const;
+
+	static void basis(const glm::vec3& dir, float Y[9]);
+
+private:
+	glm::vec3 _coeffs[9];
+};
+
+#endif
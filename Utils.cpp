@@ -1,6 +1,95 @@
 #include "Utils.h"
 
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace {
+    struct ParallelJob {
+        ParallelJob(unsigned int count, const std::function<void(unsigned int)>& task)
+            : count(count), task(task), next(0), done(0) {}
+
+        unsigned int count;
+        const std::function<void(unsigned int)>& task;
+        std::atomic<unsigned int> next;
+        unsigned int done;
+    };
+
+    // Worker threads shared by every parallelFor call, whichever thread it comes
+    // from. The calling thread runs indices of its own job too, so nested or
+    // concurrent calls always make progress, and the pipeline stages share the
+    // hardware threads instead of each spawning a full set of their own.
+    class ThreadPool {
+    public:
+        ThreadPool() {
+            unsigned int nThreads = std::max(1u, std::thread::hardware_concurrency()) - 1;
+            for (unsigned int t = 0; t < nThreads; t++)
+                std::thread(&ThreadPool::work, this).detach();
+        }
+
+        void run(unsigned int count, const std::function<void(unsigned int)>& task) {
+            std::shared_ptr<ParallelJob> job = std::make_shared<ParallelJob>(count, task);
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _jobs.push_back(job);
+            }
+            _wakeUp.notify_all();
+
+            unsigned int ran = runIndices(*job);
+
+            std::unique_lock<std::mutex> lock(_mutex);
+            finish(job, ran);
+            _finished.wait(lock, [&job] { return job->done == job->count; });
+        }
+
+    private:
+        // Runs indices until the job has none left, returns how many were run
+        static unsigned int runIndices(ParallelJob& job) {
+            unsigned int ran = 0;
+            unsigned int i;
+            while ((i = job.next++) < job.count) {
+                job.task(i);
+                ran++;
+            }
+            return ran;
+        }
+
+        // Called with the mutex held once a thread found the job exhausted
+        void finish(const std::shared_ptr<ParallelJob>& job, unsigned int ran) {
+            std::deque<std::shared_ptr<ParallelJob>>::iterator it = std::find(_jobs.begin(), _jobs.end(), job);
+            if (it != _jobs.end())
+                _jobs.erase(it);
+
+            job->done += ran;
+            if (job->done == job->count)
+                _finished.notify_all();
+        }
+
+        void work() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            for (;;) {
+                _wakeUp.wait(lock, [this] { return !_jobs.empty(); });
+                std::shared_ptr<ParallelJob> job = _jobs.front();
+
+                lock.unlock();
+                unsigned int ran = runIndices(*job);
+                lock.lock();
+
+                finish(job, ran);
+            }
+        }
+
+        std::mutex _mutex;
+        std::condition_variable _wakeUp;
+        std::condition_variable _finished;
+        std::deque<std::shared_ptr<ParallelJob>> _jobs;
+    };
+}
 
 const char* Utils::getGLErrorString(GLenum err)
 {
@@ -48,4 +137,13 @@ void Utils::throwError(const std::string& error) {
 	std::cerr << error << std::endl;
 	//std::cin.get();
 	exit(EXIT_FAILURE);
-}
\ No newline at end of file
+}
+
+void Utils::parallelFor(unsigned int count, const std::function<void(unsigned int)>& task) {
+    if (count == 0)
+        return;
+
+    // Created once and never destroyed, so that no worker has to be joined at exit
+    static ThreadPool* pool = new ThreadPool();
+    pool->run(count, task);
+}
@@ -3,12 +3,17 @@
 
 #include <GL/glew.h>
 #include <string>
+#include <functional>
 
 namespace Utils {
 	const char* getGLErrorString(GLenum err);
 	void checkOpenGLError(const std::string& error);
 	bool isOpenGLError();
 	void throwError (const std::string& error);
+
+	// Runs task(0..count-1) on a persistent pool of hardware threads, which the
+	// calling thread joins, blocking until every index is done
+	void parallelFor(unsigned int count, const std::function<void(unsigned int)>& task);
 }
 
 #endif // !__UTILS_H__
\ No newline at end of file
@@ -1,18 +1,32 @@
 #include <GL/glew.h>
-#include <GLFW/glfw3.h>
-
-#include <glm/glm.hpp>
-#include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/type_ptr.hpp>
 
 #define STB_IMAGE_IMPLEMENTATION
 #define STBI_FAILURE_USERMSG
 #include <stb_image.h>
 #include <gli/gli.hpp>
 
-#include <Shader.h>
-
+#include <BakeCache.h>
+#include <Baker.h>
+#include <Benchmark.h>
+#include <BoundedQueue.h>
+#include <BC6H.h>
+#include <BRDFLut.h>
+#include <CPUBaker.h>
+#include <DDSWriter.h>
+#include <GLContext.h>
+#include <HDRImage.h>
+#include <ProbeBundle.h>
+#include <RGB9E5.h>
+#include <RGBM.h>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <string>
 #include <filesystem>
@@ -22,434 +36,649 @@ namespace fs = std::filesystem;
 #define IRRADIANCEMAP_RES 128
 #define PREFILTERMAP_RES 512
 #define MAXMIPLEVELS 5
+// GGX samples of every prefilter level, 0 scales them with the roughness of the level
+#define PREFILTER_SAMPLES 0
+// Light samples of --light-sampling, see BakeOptions::lightSamples
+#define LIGHT_SAMPLES 256
+// Split-sum BRDF LUT, baked once for all images into output/brdf_lut.dds
+#define BRDFLUT_RES 512
+#define BRDFLUT_SAMPLES 1024
+
+// Batch pipeline: threads decoding and saving images around the bake, and how many
+// images may wait between two stages
+#define DECODE_THREADS 2
+#define WRITE_THREADS 2
+#define PIPELINE_DEPTH 1
+// Texels per environment face baked together by --array, summed over the layers of a
+// batch, which share every pass
+#define ARRAY_BATCH_TEXELS (4 * 1024 * 1024)
+
+fs::path getSaveFolder(const std::string& filepath) {
+    fs::path p = fs::path(filepath);
+    fs::path savefolder = fs::path(p.parent_path().parent_path().string() + "/output/" + p.stem().string());
+    if (!fs::exists(savefolder)) {
+        fs::create_directory(savefolder);
+    }
+    return savefolder;
+}
 
-void renderQuad();
-void renderCube();
+// Serializes the progress messages of the pipeline threads
+static std::mutex logMutex;
 
-static void error_callback(int error, const char* description) {
-	fprintf(stderr, "Error: %s\n", description);
+// RGBM and RGBD cubemaps are saved with the range of each level, e.g. env_range.txt next to env.dds
+bool hasRanges(const BakeOptions& options) {
+    return options.outputFormat == OutputFormat::RGBM || options.outputFormat == OutputFormat::RGBD;
 }
 
-static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
-	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
-		glfwSetWindowShouldClose(window, GLFW_TRUE);
+std::string rangesFilename(const std::string& filename) {
+    return fs::path(filename).stem().string() + "_range.txt";
 }
 
-void generateMaps(std::string filepath) {
-    fs::path p = fs::path(filepath);
-    fs::path savefolder = fs::path(p.parent_path().parent_path().string() + "/output/" + p.stem().string());
-    if (!fs::exists(savefolder)) {
-        fs::create_directory(savefolder);
-    }
+// File and log names of the maps, in BakeMap order
+static const char* MAP_FILENAMES[] = { "env.dds", "irradiance.dds", "ggx.dds" };
+static const char* MAP_NAMES[] = { "Environment", "Irradiance", "Prefilter" };
+
+gli::format encodedFormat(const BakeOptions& options) {
+    if (options.outputFormat == OutputFormat::BC6H)
+        return gli::FORMAT_RGB_BP_UFLOAT_BLOCK16;
+    if (options.outputFormat == OutputFormat::RGB9E5)
+        return gli::FORMAT_RGB9E5_UFLOAT_PACK32;
+    if (hasRanges(options))
+        return options.bc3 ? gli::FORMAT_RGBA_DXT5_UNORM_BLOCK16 : gli::FORMAT_RGBA8_UNORM_PACK8;
+    return gli::FORMAT_RGB16_SFLOAT_PACK16;
+}
 
-	// Load shaders...
-    ShaderSource convolutionVS = ShaderSource(GL_VERTEX_SHADER, "shaders/convolution.vs");
-    ShaderSource eqFS = ShaderSource(GL_FRAGMENT_SHADER, "shaders/equirectangular.fs");
-    Shader equirectangularToCubemapShdr = Shader("equirectangularToCubemapShdr");
-    equirectangularToCubemapShdr.addShader(convolutionVS);
-    equirectangularToCubemapShdr.addShader(eqFS);
-    equirectangularToCubemapShdr.link();
-
-    ShaderSource irrFS = ShaderSource(GL_FRAGMENT_SHADER, "shaders/irradiance.fs");
-    Shader irradianceShdr = Shader("irradianceShdr");
-    irradianceShdr.addShader(convolutionVS);
-    irradianceShdr.addShader(irrFS);
-    irradianceShdr.link();
-
-    ShaderSource prefFS = ShaderSource(GL_FRAGMENT_SHADER, "shaders/prefilter.fs");
-    Shader prefilterShdr = Shader("prefilterShdr");
-    prefilterShdr.addShader(convolutionVS);
-    prefilterShdr.addShader(prefFS);
-    prefilterShdr.link();
-
-	// Setup framebuffer
-    unsigned int captureFBO;
-    unsigned int captureRBO;
-    glGenFramebuffers(1, &captureFBO);
-    glGenRenderbuffers(1, &captureRBO);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, ENVMAP_RES, ENVMAP_RES);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, captureRBO);
-
-    // Load image
-    stbi_set_flip_vertically_on_load(true);
-    int width, height, nrComponents;
-    float* data = stbi_loadf(filepath.c_str(), &width, &height, &nrComponents, 0);
-    unsigned int hdrTexture;
-    if (data)
-    {
-        glGenTextures(1, &hdrTexture);
-        glBindTexture(GL_TEXTURE_2D, hdrTexture);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, data);
+// Encodes the cubemap to the output format on the calling writer thread, ranges receives
+// the RGBM and RGBD range of each level
+gli::texture_cube encodeCubemap(const gli::texture_cube& cubemap, const BakeOptions& options, std::vector<float>& ranges) {
+    if (options.outputFormat == OutputFormat::BC6H)
+        return BC6H::encode(cubemap, options.bc6hQuality);
+    if (options.outputFormat == OutputFormat::RGB9E5)
+        return RGB9E5::encode(cubemap);
+    if (hasRanges(options))
+        return RGBM::encode(cubemap, options.outputFormat, options.bc3, ranges);
+    return cubemap;
+}
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+// Same as encodeCubemap(), writing every face and level to layer of writer as soon as it is
+// encoded instead of building the encoded cubemap: only one face is held encoded at a time.
+// RGB16F faces are written straight from the cubemap storage.
+bool writeCubemap(DDSWriter& writer, unsigned int layer, const gli::texture_cube& cubemap, const BakeOptions& options, std::vector<float>& ranges) {
+    std::vector<unsigned char> encoded;
+    if (hasRanges(options))
+        ranges.resize(cubemap.levels());
+    for (size_t level = 0; level < cubemap.levels(); level++) {
+        unsigned int size = (unsigned int)cubemap.extent(level).x;
+        if (hasRanges(options))
+            ranges[level] = RGBM::fitRange(cubemap, level, options.outputFormat, options.bc3);
+        encoded.resize(writer.size((unsigned int)level));
+
+        for (unsigned int face = 0; face < 6; face++) {
+            const glm::uint16* rgb = cubemap.data<glm::uint16>(0, face, level);
+            const void* data = encoded.data();
+            if (options.outputFormat == OutputFormat::BC6H)
+                BC6H::encodeFace(rgb, size, options.bc6hQuality, encoded.data());
+            else if (options.outputFormat == OutputFormat::RGB9E5)
+                RGB9E5::encode(rgb, (glm::uint32*)encoded.data(), (size_t)size * size);
+            else if (hasRanges(options))
+                RGBM::encodeFace(rgb, size, ranges[level], options.outputFormat, options.bc3, encoded.data());
+            else
+                data = rgb;
+
+            if (!writer.write(face, (unsigned int)level, data, layer))
+                return false;
+        }
+    }
+    return true;
+}
 
-        stbi_image_free(data);
+void saveCubemap(const gli::texture_cube& cubemap, const fs::path& savefolder, BakeMap map, const BakeOptions& options) {
+    std::string filename = MAP_FILENAMES[(int)map];
+    std::string name = MAP_NAMES[(int)map];
+    std::string savepath = savefolder.string() + "/" + filename;
+    std::vector<float> ranges;
+    DDSWriter writer;
+    bool saved = writer.open(savepath, encodedFormat(options), (unsigned int)cubemap.extent().x, (unsigned int)cubemap.levels()) &&
+                 writeCubemap(writer, 0, cubemap, options, ranges);
+    saved = writer.close() && saved;
+    if (hasRanges(options))
+        saved = saved && RGBM::saveRanges(ranges, (savefolder / rangesFilename(filename)).string());
+
+    std::lock_guard<std::mutex> lock(logMutex);
+    if (!saved) {
+        std::cout << "[ERROR] Failed to save " << name << " cubemap!" << std::endl;
+        exit(EXIT_FAILURE);
     }
-    else
-    {
-        std::cout << "Failed to load HDR image: " << stbi_failure_reason() << std::endl;
+    std::cout << name << " Cubemap saved at: " << savepath << std::endl;
+}
+
+// Saves every map of the image, and a copy of the BRDF LUT, to a single probe.bundle
+void saveBundle(const BakeResult& result, const fs::path& savefolder, const BakeOptions& options, const gli::texture2d& brdfLut) {
+    ProbeBundle bundle;
+    std::vector<float> ranges;
+    // There is no env.dds to bake from in bundle mode, the environment map is always baked
+    bundle.add(BundleKind::Environment, encodeCubemap(result.envMap, options, ranges), ranges);
+    if (!result.irradianceMap.empty())
+        bundle.add(BundleKind::Irradiance, encodeCubemap(result.irradianceMap, options, ranges), ranges);
+    bundle.add(BundleKind::Prefilter, encodeCubemap(result.prefilterMap, options, ranges), ranges);
+    if (options.irradiance != IrradianceMode::Convolution)
+        bundle.add(result.irradianceSH);
+    bundle.add(BundleKind::BRDFLut, brdfLut);
+
+    std::string savepath = (savefolder / "probe.bundle").string();
+    bool saved = bundle.save(savepath);
+
+    std::lock_guard<std::mutex> lock(logMutex);
+    if (!saved) {
+        std::cout << "[ERROR] Failed to save probe bundle!" << std::endl;
         exit(EXIT_FAILURE);
     }
+    std::cout << "Probe bundle saved at: " << savepath << std::endl;
+}
 
-	// Setup cubemap
-    unsigned int envCubemap;
-    glGenTextures(1, &envCubemap);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
-    for (unsigned int i = 0; i < 6; ++i)
-    {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, ENVMAP_RES, ENVMAP_RES, 0, GL_RGB, GL_FLOAT, nullptr);
+void saveIrradianceSH(const SphericalHarmonics& irradianceSH, const fs::path& savefolder) {
+    std::string savepath = savefolder.string() + "/" + "irradiance_sh.txt";
+    bool saved = irradianceSH.save(savepath);
+
+    std::lock_guard<std::mutex> lock(logMutex);
+    if (!saved) {
+        std::cout << "[ERROR] Failed to save irradiance SH coefficients!" << std::endl;
+        exit(EXIT_FAILURE);
     }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR); // enable pre-filter mipmap sampling (combatting visible dots artifact)
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	// Setup view + proj matrices
-	glm::mat4 captureProjection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
-	glm::mat4 captureViews[] =
-	{
-		glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
-		glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(-1.0f,  0.0f,  0.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
-		glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f,  1.0f,  0.0f), glm::vec3(0.0f,  0.0f,  1.0f)),
-		glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f,  0.0f), glm::vec3(0.0f,  0.0f, -1.0f)),
-		glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f,  0.0f,  1.0f), glm::vec3(0.0f, -1.0f,  0.0f)),
-		glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f,  0.0f, -1.0f), glm::vec3(0.0f, -1.0f,  0.0f))
-	};
-
-    // Convert Equirectangular to Cubemap
-    glUseProgram(equirectangularToCubemapShdr.id());
-    glUniform1i(glGetUniformLocation(equirectangularToCubemapShdr.id(), "equirectangularMap"), 0);
-    glUniformMatrix4fv(glGetUniformLocation(equirectangularToCubemapShdr.id(), "projection"), 1, GL_FALSE, glm::value_ptr(captureProjection));
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, hdrTexture);
-
-    glViewport(0, 0, ENVMAP_RES, ENVMAP_RES); // don't forget to configure the viewport to the capture dimensions.
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    for (unsigned int i = 0; i < 6; ++i)
-    {
-        glUniformMatrix4fv(glGetUniformLocation(equirectangularToCubemapShdr.id(), "view"), 1, GL_FALSE, glm::value_ptr(captureViews[i]));
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, envCubemap, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    std::cout << "Irradiance SH coefficients saved at: " << savepath << std::endl;
+}
 
-        renderCube();
+// Output of --array: every map of an image is written to its layer of output/array/env.dds,
+// irradiance.dds or ggx.dds as soon as it is baked. The files are opened with the format,
+// size and levels of the first layer written, which all layers share. The manifest of the
+// folder is saved with keys once every layer is.
+class ArrayOutput {
+public:
+    ArrayOutput(const fs::path& savefolder, const BakeOptions& options, const std::vector<std::string>& filepaths, const BakeKeys& keys)
+        : _savefolder(savefolder), _options(options), _filepaths(filepaths), _keys(keys), _sh(filepaths.size()) {
+        for (int i = 0; i < 3; i++) {
+            _maps[i].filename = MAP_FILENAMES[i];
+            _maps[i].name = MAP_NAMES[i];
+            _maps[i].ranges.resize(filepaths.size());
+        }
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    // then let OpenGL generate mipmaps from first mip face (combatting visible dots artifact)
-    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
-    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
-    
-    // Store cubemap into .dds file
-    gli::texture_cube envCubeMapDDS = gli::texture_cube(gli::FORMAT_RGB16_SFLOAT_PACK16, gli::extent2d(ENVMAP_RES, ENVMAP_RES));
-    for (int face = 0; face < 6; face++) {
-        float* texData = new float[3 * ENVMAP_RES * ENVMAP_RES];
-        glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGB, GL_FLOAT, texData);
-        for (int y = 0; y < ENVMAP_RES; y++) {
-            for (int x = 0; x < ENVMAP_RES; x++) {
-                unsigned int row = y * ENVMAP_RES * 3;
-                unsigned int col = x * 3;
-                glm::vec3 texelData = glm::vec3(texData[row + col], texData[row + col + 1], texData[row + col + 2]);
-                envCubeMapDDS.store<glm::highp_u16vec3>({ x, y }, face, 0, gli::packHalf(texelData));
+
+    // Encodes on the calling writer thread, one face at a time, each written as soon as it is encoded
+    void writeMap(size_t layer, BakeMap map, const gli::texture_cube& cubemap) {
+        Map& output = _maps[(int)map];
+        {
+            std::lock_guard<std::mutex> lock(output.mutex);
+            if (!output.writer.isOpen()) {
+                std::string savepath = (_savefolder / output.filename).string();
+                if (!output.writer.open(savepath, encodedFormat(_options), (unsigned int)cubemap.extent().x, (unsigned int)cubemap.levels(), (unsigned int)_filepaths.size()))
+                    fail(std::string(output.name) + " cubemap array");
             }
         }
-        delete[] texData;
-    }
 
-    if (!gli::save(envCubeMapDDS, savefolder.string() + "/" + "env.dds")) {
-        std::cout << "[ERROR] Failed to save environment cubemap!" << std::endl;
-        exit(EXIT_FAILURE);
-    }
-    std::cout << "Environment Cubemap saved at: " << savefolder.string() + "/" + "env.dds" << std::endl;
+        std::vector<float> ranges;
+        if (!writeCubemap(output.writer, (unsigned int)layer, cubemap, _options, ranges))
+            fail(std::string(output.name) + " cubemap array");
 
-    // Init Irradiance cubemap
-    unsigned int irradianceMap;
-    glGenTextures(1, &irradianceMap);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
-    for (unsigned int i = 0; i < 6; ++i)
-    {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, IRRADIANCEMAP_RES, IRRADIANCEMAP_RES, 0, GL_RGB, GL_FLOAT, nullptr);
+        std::lock_guard<std::mutex> lock(output.mutex);
+        output.ranges[layer] = ranges;
     }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, IRRADIANCEMAP_RES, IRRADIANCEMAP_RES);
-
-    // Generate irradiance data
-    glUseProgram(irradianceShdr.id());
-    glUniform1i(glGetUniformLocation(irradianceShdr.id(), "environmentMap"), 0);
-    glUniformMatrix4fv(glGetUniformLocation(irradianceShdr.id(), "projection"), 1, GL_FALSE, glm::value_ptr(captureProjection));
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
-
-    glViewport(0, 0, IRRADIANCEMAP_RES, IRRADIANCEMAP_RES); // don't forget to configure the viewport to the capture dimensions.
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    for (unsigned int i = 0; i < 6; ++i)
-    {
-        glUniformMatrix4fv(glGetUniformLocation(irradianceShdr.id(), "view"), 1, GL_FALSE, glm::value_ptr(captureViews[i]));
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, irradianceMap, 0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        renderCube();
+    // Called once every map of the layer is written
+    void finishLayer(size_t layer, const BakeResult& result) {
+        _sh[layer] = result.irradianceSH;
+
+        std::lock_guard<std::mutex> lock(logMutex);
+        std::cout << "Layer " << layer << " written: " << _filepaths[layer] << std::endl;
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    // Store cubemap into .dds file
-    glBindTexture(GL_TEXTURE_CUBE_MAP, irradianceMap);
-    gli::texture_cube irradianceMapDDS = gli::texture_cube(gli::FORMAT_RGB16_SFLOAT_PACK16, gli::extent2d(IRRADIANCEMAP_RES, IRRADIANCEMAP_RES));
-    for (int face = 0; face < 6; face++) {
-        float* texData = new float[3 * IRRADIANCEMAP_RES * IRRADIANCEMAP_RES];
-        glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGB, GL_FLOAT, texData);
-        for (int y = 0; y < IRRADIANCEMAP_RES; y++) {
-            for (int x = 0; x < IRRADIANCEMAP_RES; x++) {
-                unsigned int row = y * IRRADIANCEMAP_RES * 3;
-                unsigned int col = x * 3;
-                glm::vec3 texelData = glm::vec3(texData[row + col], texData[row + col + 1], texData[row + col + 2]);
-                irradianceMapDDS.store<glm::highp_u16vec3>({ x, y }, face, 0, gli::packHalf(texelData));
 
-            }
+    // Closes the files and saves the ranges, SH coefficients and layers.txt next to them
+    void close() {
+        for (Map& map : _maps) {
+            if (!map.writer.isOpen())
+                continue;
+            bool saved = map.writer.close();
+            if (hasRanges(_options))
+                saved = saved && RGBM::saveRanges(map.ranges, (_savefolder / rangesFilename(map.filename)).string());
+            if (!saved)
+                fail(std::string(map.name) + " cubemap array");
+            std::cout << map.name << " Cubemap array saved at: " << map.writer.filepath() << std::endl;
         }
-        delete[] texData;
+
+        if (_options.irradiance != IrradianceMode::Convolution) {
+            std::string savepath = (_savefolder / "irradiance_sh.txt").string();
+            std::ofstream file(savepath, std::ios_base::out | std::ios_base::trunc);
+            for (const SphericalHarmonics& sh : _sh)
+                sh.save(file);
+            if (file.fail())
+                fail("irradiance SH coefficients");
+            std::cout << "Irradiance SH coefficients saved at: " << savepath << std::endl;
+        }
+
+        std::ofstream layers((_savefolder / "layers.txt").string(), std::ios_base::out | std::ios_base::trunc);
+        for (const std::string& filepath : _filepaths)
+            layers << fs::path(filepath).filename().string() << "\n";
+        layers.close();
+        if (layers.fail())
+            fail("array layers");
+
+        if (!BakeCache::save(_savefolder.string(), _keys))
+            std::cout << "[WARNING] Failed to save bake manifest, the cubemap array will be baked again" << std::endl;
     }
 
-    if (!gli::save(irradianceMapDDS, savefolder.string() + "/" + "irradiance.dds")) {
-        std::cout << "[ERROR] Failed to save irradiance cubemap!" << std::endl;
+private:
+    struct Map {
+        const char* filename;
+        const char* name;
+        std::mutex mutex;
+        DDSWriter writer;
+        std::vector<std::vector<float>> ranges;     // of every layer, RGBM and RGBD only
+    };
+
+    static void fail(const std::string& what) {
+        std::lock_guard<std::mutex> lock(logMutex);
+        std::cout << "[ERROR] Failed to save " << what << "!" << std::endl;
         exit(EXIT_FAILURE);
     }
-    std::cout << "Irradiance Cubemap saved at: " << savefolder.string() + "/" + "irradiance.dds" << std::endl;
 
-    // Init prefilter Cubemap
-    unsigned int prefilterMap;
-    glGenTextures(1, &prefilterMap);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
-    for (unsigned int i = 0; i < 6; ++i)
-    {
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, PREFILTERMAP_RES, PREFILTERMAP_RES, 0, GL_RGB, GL_FLOAT, nullptr);
+    fs::path _savefolder;
+    const BakeOptions& _options;
+    const std::vector<std::string>& _filepaths;
+    BakeKeys _keys;
+    Map _maps[3];
+    std::vector<SphericalHarmonics> _sh;
+};
+
+bool outputsExist(const fs::path& savefolder, const BakeOptions& options) {
+    if (options.bundle)
+        return fs::exists(savefolder / "probe.bundle");
+
+    bool exist = fs::exists(savefolder / "env.dds") && fs::exists(savefolder / "ggx.dds");
+    if (options.irradiance != IrradianceMode::SHOnly)
+        exist = exist && fs::exists(savefolder / "irradiance.dds");
+    if (options.irradiance != IrradianceMode::Convolution)
+        exist = exist && fs::exists(savefolder / "irradiance_sh.txt");
+    if (hasRanges(options)) {
+        exist = exist && fs::exists(savefolder / rangesFilename("env.dds")) && fs::exists(savefolder / rangesFilename("ggx.dds"));
+        if (options.irradiance != IrradianceMode::SHOnly)
+            exist = exist && fs::exists(savefolder / rangesFilename("irradiance.dds"));
     }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
-
-    // Generate prefilter cubemap
-    glUseProgram(prefilterShdr.id());
-    glUniform1i(glGetUniformLocation(prefilterShdr.id(), "environmentMap"), 0);
-    glUniformMatrix4fv(glGetUniformLocation(prefilterShdr.id(), "projection"), 1, GL_FALSE, glm::value_ptr(captureProjection));
-
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, envCubemap);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
-    for (unsigned int mip = 0; mip < MAXMIPLEVELS; ++mip)
-    {
-        // reisze framebuffer according to mip-level size.
-        unsigned int mipWidth = PREFILTERMAP_RES * std::pow(0.5, mip);
-        unsigned int mipHeight = PREFILTERMAP_RES * std::pow(0.5, mip);
-        glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
-        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mipWidth, mipHeight);
-        glViewport(0, 0, mipWidth, mipHeight);
-
-        float roughness = (float)mip / (float)(MAXMIPLEVELS - 1);
-        glUniform1f(glGetUniformLocation(prefilterShdr.id(), "roughness"), roughness);
-        for (unsigned int i = 0; i < 6; ++i)
-        {
-            glUniformMatrix4fv(glGetUniformLocation(prefilterShdr.id(), "view"), 1, GL_FALSE, glm::value_ptr(captureViews[i]));
-            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, prefilterMap, mip);
+    return exist;
+}
 
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-            renderCube();
+// Bakes the BRDF LUT unless the one in folder was made with the same parameters, in which case it is loaded
+gli::texture2d bakeBRDFLut(const fs::path& savefolder, bool useCache) {
+    std::string savepath = (savefolder / "brdf_lut.dds").string();
+    uint64_t key = BakeCache::lutKey(BRDFLUT_RES, BRDFLUT_SAMPLES);
+    uint64_t savedKey;
+    if (useCache && fs::exists(savepath) && BakeCache::loadLUT(savefolder.string(), savedKey) && savedKey == key) {
+        gli::texture2d lut(gli::load(savepath));
+        if (!lut.empty()) {
+            std::cout << "BRDF LUT up to date: " << savepath << std::endl;
+            return lut;
         }
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    // Store cubemap into .dds file
-    glBindTexture(GL_TEXTURE_CUBE_MAP, prefilterMap);
-    gli::texture_cube prefilterMapDDS = gli::texture_cube(gli::FORMAT_RGB16_SFLOAT_PACK16, gli::extent2d(PREFILTERMAP_RES, PREFILTERMAP_RES), MAXMIPLEVELS);
-
-    for (unsigned int mip = 0; mip < MAXMIPLEVELS; ++mip) {
-        for (int face = 0; face < 6; face++) {
-            unsigned int mipRes = PREFILTERMAP_RES * std::pow(0.5, mip);
-            float* texData = new float[3 * mipRes * mipRes];
-            glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, mip, GL_RGB, GL_FLOAT, texData);
-            for (int y = 0; y < mipRes; y++) {
-                for (int x = 0; x < mipRes; x++) {
-                    unsigned int row = y * mipRes * 3;
-                    unsigned int col = x * 3;
-                    glm::vec3 texelData = glm::vec3(texData[row + col], texData[row + col + 1], texData[row + col + 2]);
-                    prefilterMapDDS.store<glm::highp_u16vec3>({ x, y }, face, mip, gli::packHalf(texelData));
 
-                }
+    BakeCache::invalidateLUT(savefolder.string());
+    gli::texture2d lut = BRDFLut::generate(BRDFLUT_RES, BRDFLUT_SAMPLES);
+    if (!gli::save(lut, savepath)) {
+        std::cout << "[ERROR] Failed to save BRDF LUT!" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    std::cout << "BRDF LUT saved at: " << savepath << std::endl;
+
+    if (!BakeCache::saveLUT(savefolder.string(), key))
+        std::cout << "[WARNING] Failed to save BRDF LUT manifest, it will be baked again" << std::endl;
+    return lut;
+}
+
+struct DecodedImage {
+    std::string filepath;
+    size_t index = 0;           // in the batch, the array layer with --array
+    BakeKeys keys;
+    bool upToDate = false;      // the outputs already match the keys, nothing to bake
+    gli::texture_cube envMap;   // environment map of a previous bake to start from, instead of image
+    HDRImage image;
+};
+
+// Outputs of one baked image. Each map is saved by its own job as soon as the baker hands
+// it over, and a last job saves what the baker kept in result. The manifest is saved, or the
+// layer reported, by whichever job ends last.
+struct ImageOutput {
+    std::string filepath;
+    size_t index;
+    BakeKeys keys;
+    fs::path savefolder;            // empty with --array
+    BakeResult result;              // set before the last job is queued
+    std::atomic<unsigned int> pending;
+};
+
+struct SaveJob {
+    std::shared_ptr<ImageOutput> image;
+    BakeMap map;
+    gli::texture_cube cubemap;      // empty for the last job of the image
+};
+
+// Reads one input and looks its keys up in the manifest of its output folder.
+// The image is only decoded when the cache can't provide its environment map.
+DecodedImage decodeImage(const std::string& filepath, size_t index, const BakeCache& cache, const BakeOptions& options) {
+    DecodedImage decoded;
+    decoded.filepath = filepath;
+    decoded.index = index;
+
+    std::ifstream input(filepath, std::ios_base::in | std::ios_base::binary);
+    std::vector<unsigned char> file((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    decoded.keys = cache.keys(file);
+
+    // Array layers have no folder of their own, the array has a single manifest
+    fs::path savefolder = options.cubemapArray ? fs::path() : getSaveFolder(filepath);
+    BakeKeys cached;
+    if (options.useCache && !options.cubemapArray && BakeCache::load(savefolder.string(), cached)) {
+        if (cached.maps == decoded.keys.maps && outputsExist(savefolder, options)) {
+            decoded.upToDate = true;
+            return decoded;
+        }
+        if (cached.env == decoded.keys.env) {
+            gli::texture_cube envMap(gli::load((savefolder / "env.dds").string()));
+            if (!envMap.empty() && envMap.format() == gli::FORMAT_RGB16_SFLOAT_PACK16 && envMap.extent().x == (int)options.envRes) {
+                decoded.envMap = envMap;
+                return decoded;
             }
-            delete[] texData;
         }
     }
 
-    if (!gli::save(prefilterMapDDS, savefolder.string() + "/" + "ggx.dds")) {
-        std::cout << "[ERROR] Failed to save prefilter cubemap!" << std::endl;
+    if (input.fail() || !decoded.image.load(file)) {
+        std::lock_guard<std::mutex> lock(logMutex);
+        std::cout << "Failed to load HDR image: " << (input.fail() ? "can't fopen" : decoded.image.error()) << std::endl;
         exit(EXIT_FAILURE);
     }
-    std::cout << "Prefilter Cubemap saved at: " << savefolder.string() + "/" + "ggx.dds" << std::endl;
+    return decoded;
 }
 
-unsigned int quadVAO = 0;
-unsigned int quadVBO;
-void renderQuad() {
-    if (quadVAO == 0) {
-        float quadVertices[] = {
-            // positions        // texture Coords
-            -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
-            -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
-             1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
-             1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
-        };
-        // setup plane VAO
-        glGenVertexArrays(1, &quadVAO);
-        glGenBuffers(1, &quadVBO);
-        glBindVertexArray(quadVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+// Keys of the whole --array batch, which reads every input once more up front
+BakeKeys arrayKeys(const std::vector<std::string>& filepaths, const BakeCache& cache) {
+    std::vector<std::string> names;
+    std::vector<BakeKeys> layers;
+    for (const std::string& filepath : filepaths) {
+        std::ifstream input(filepath, std::ios_base::in | std::ios_base::binary);
+        std::vector<unsigned char> file((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+        names.push_back(fs::path(filepath).filename().string());
+        layers.push_back(cache.keys(file));
     }
-    glBindVertexArray(quadVAO);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
+    return BakeCache::arrayKeys(names, layers);
 }
 
-unsigned int cubeVAO = 0;
-unsigned int cubeVBO = 0;
-void renderCube() {
-    // initialize (if necessary)
-    if (cubeVAO == 0) {
-        float vertices[] = {
-            // back face
-            -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 0.0f, // bottom-left
-            1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 1.0f, // top-right
-            1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 0.0f, // bottom-right         
-            1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 1.0f, // top-right
-            -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 0.0f, // bottom-left
-            -1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 1.0f, // top-left
-                                                                  // front face
-            -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 0.0f, // bottom-left
-            1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 0.0f, // bottom-right
-            1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 1.0f, // top-right
-            1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 1.0f, // top-right
-            -1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 1.0f, // top-left
-            -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 0.0f, // bottom-left
-                                                                // left face
-            -1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-right
-            -1.0f,  1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 1.0f, // top-left
-            -1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-left
-            -1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-left
-            -1.0f, -1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 0.0f, // bottom-right
-            -1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-right
-            // right face
-            1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-left
-            1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-right
-            1.0f,  1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 1.0f, // top-right         
-            1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-right
-            1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-left
-            1.0f, -1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 0.0f, // bottom-left     
-                                                                // bottom face
-            -1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, // top-right
-            1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 1.0f, // top-left
-            1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 0.0f, // bottom-left
-            1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 0.0f, // bottom-left
-            -1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 0.0f, // bottom-right
-            -1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, // top-right
-            // top face
-            -1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, // top-left
-            1.0f,  1.0f , 1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 0.0f, // bottom-right
-            1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 1.0f, // top-right     
-            1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 0.0f, // bottom-right
-            -1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, // top-left                                                                                                                                                 
-            -1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 0.0f  // bottom-left        
-        };
-        glGenVertexArrays(1, &cubeVAO);
-        glGenBuffers(1, &cubeVBO);
-        // fill buffer
-        glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-        // link vertex attributes
-        glBindVertexArray(cubeVAO);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
+// Bakes every file as a three stage pipeline: worker threads decode the next images
+// while the calling thread, which owns the GL context, bakes the current one and other
+// workers save each map of it as soon as it is read back. The bounded queues between the stages limit how many
+// images are held in memory, and the batch takes about as long as its slowest stage.
+template <typename BakerType>
+void bakeBatch(BakerType& baker, const std::vector<std::string>& filepaths, const BakeOptions& options, const gli::texture2d& brdfLut) {
+    BakeCache cache(options, BakeCache::lutKey(BRDFLUT_RES, BRDFLUT_SAMPLES));
+
+    // The array is skipped as a whole when its manifest matches every layer
+    std::unique_ptr<ArrayOutput> array;
+    if (options.cubemapArray) {
+        fs::path savefolder = fs::current_path() / "output" / "array";
+        if (!fs::exists(savefolder))
+            fs::create_directory(savefolder);
+
+        BakeKeys keys = arrayKeys(filepaths, cache);
+        BakeKeys cached;
+        if (options.useCache && BakeCache::load(savefolder.string(), cached) && cached.maps == keys.maps &&
+            outputsExist(savefolder, options) && fs::exists(savefolder / "layers.txt")) {
+            std::cout << "Skipping the cubemap array, its maps are up to date" << std::endl;
+            return;
+        }
+        BakeCache::invalidate(savefolder.string());
+        array.reset(new ArrayOutput(savefolder, options, filepaths, keys));
     }
-    // render Cube
-    glBindVertexArray(cubeVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
+
+    // Every image queues up to three maps and its last job
+    BoundedQueue<DecodedImage> decoded(PIPELINE_DEPTH);
+    BoundedQueue<SaveJob> saves(PIPELINE_DEPTH * 4);
+
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> decoders;
+    for (unsigned int i = 0; i < DECODE_THREADS; i++) {
+        decoders.emplace_back([&]() {
+            for (size_t file = next++; file < filepaths.size(); file = next++)
+                decoded.push(decodeImage(filepaths[file], file, cache, options));
+        });
+    }
+
+    std::vector<std::thread> writers;
+    for (unsigned int i = 0; i < WRITE_THREADS; i++) {
+        writers.emplace_back([&]() {
+            SaveJob job;
+            while (saves.pop(job)) {
+                ImageOutput& image = *job.image;
+                if (!job.cubemap.empty()) {
+                    if (array)
+                        array->writeMap(image.index, job.map, job.cubemap);
+                    else
+                        saveCubemap(job.cubemap, image.savefolder, job.map, options);
+                }
+                else if (options.bundle) {
+                    saveBundle(image.result, image.savefolder, options, brdfLut);
+                }
+                else if (!array && options.irradiance != IrradianceMode::Convolution) {
+                    saveIrradianceSH(image.result.irradianceSH, image.savefolder);
+                }
+                // Frees the map before waiting for the next job
+                job.cubemap = gli::texture_cube();
+
+                if (--image.pending > 0)
+                    continue;
+                if (array) {
+                    array->finishLayer(image.index, image.result);
+                }
+                else if (!BakeCache::save(image.savefolder.string(), image.keys)) {
+                    std::lock_guard<std::mutex> lock(logMutex);
+                    std::cout << "[WARNING] Failed to save bake manifest, " << image.filepath << " will be baked again" << std::endl;
+                }
+            }
+        });
+    }
+
+    // The previous manifest of a folder goes before any of its files is rewritten
+    auto startOutput = [&](const DecodedImage& image) {
+        std::shared_ptr<ImageOutput> output = std::make_shared<ImageOutput>();
+        output->filepath = image.filepath;
+        output->index = image.index;
+        output->keys = image.keys;
+        output->pending = 1;
+        if (!array) {
+            output->savefolder = getSaveFolder(image.filepath);
+            BakeCache::invalidate(output->savefolder.string());
+        }
+        return output;
+    };
+    auto finishOutput = [&](const std::shared_ptr<ImageOutput>& output, BakeResult&& result) {
+        output->result = std::move(result);
+        saves.push(SaveJob{ output, BakeMap::Environment, gli::texture_cube() });
+    };
+
+    // Array layers are baked in groups, every pass of the baker covering a whole group
+    size_t groupSize = std::max<size_t>(1, ARRAY_BATCH_TEXELS / ((size_t)options.envRes * options.envRes));
+    std::vector<DecodedImage> group;
+    auto bakeGroup = [&]() {
+        std::vector<const HDRImage*> images;
+        std::vector<std::shared_ptr<ImageOutput>> outputs;
+        for (const DecodedImage& image : group) {
+            images.push_back(&image.image);
+            outputs.push_back(startOutput(image));
+        }
+        std::vector<BakeResult> results = baker.bake(images, [&](size_t layer, BakeMap map, gli::texture_cube&& cubemap) {
+            outputs[layer]->pending++;
+            saves.push(SaveJob{ outputs[layer], map, std::move(cubemap) });
+        });
+        for (size_t layer = 0; layer < group.size(); layer++)
+            finishOutput(outputs[layer], std::move(results[layer]));
+        group.clear();
+    };
+
+    // Every decoded image is baked exactly once, whatever order the decoders finish in
+    for (size_t i = 0; i < filepaths.size(); i++) {
+        DecodedImage image;
+        decoded.pop(image);
+        if (image.upToDate) {
+            std::lock_guard<std::mutex> lock(logMutex);
+            std::cout << "Skipping " << image.filepath << ", its maps are up to date" << std::endl;
+            continue;
+        }
+
+        if (array) {
+            group.push_back(std::move(image));
+            if (group.size() == groupSize)
+                bakeGroup();
+            continue;
+        }
+
+        // Bundles hold every map in one file, written once the bake is done
+        std::shared_ptr<ImageOutput> output = startOutput(image);
+        BakeSink sink;
+        if (!options.bundle) {
+            sink = [&](size_t, BakeMap map, gli::texture_cube&& cubemap) {
+                output->pending++;
+                saves.push(SaveJob{ output, map, std::move(cubemap) });
+            };
+        }
+        BakeResult result = image.envMap.empty() ? baker.bake(image.image, sink) : baker.bake(image.envMap, sink);
+        finishOutput(output, std::move(result));
+    }
+    if (!group.empty())
+        bakeGroup();
+    saves.close();
+
+    for (std::thread& decoder : decoders)
+        decoder.join();
+    for (std::thread& writer : writers)
+        writer.join();
+    if (array)
+        array->close();
 }
 
 int main(int argc, char* argv[]) {
-	int width, height;
-    width = height = 512;
-
-
-	glfwSetErrorCallback(error_callback);
-	// Initialize GLFW
-	if (!glfwInit())
-		exit(EXIT_FAILURE);
-
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-	//Enable MSAA
-	glfwWindowHint(GLFW_SAMPLES, 4);
-
-	GLFWwindow* window = glfwCreateWindow(width, height, "PBR Baker", NULL, NULL);
-	if (!window)
-	{
-		glfwTerminate();
-		exit(EXIT_FAILURE);
-	}
-
-	//Initialize GLEW
-	glfwSetKeyCallback(window, key_callback);
-	glfwMakeContextCurrent(window);
-	glewExperimental = GL_TRUE;
-	GLenum err = glewInit();
-	if (GLEW_OK != err)
-	{
-		std::cerr << "ERROR: " << glewGetErrorString(err) << std::endl;
-	}
+    BakeOptions options;
+    bool headless = false;
+    options.envRes = ENVMAP_RES;
+    options.irradianceRes = IRRADIANCEMAP_RES;
+    options.prefilterRes = PREFILTERMAP_RES;
+    options.prefilterLevels = MAXMIPLEVELS;
+    options.prefilterSamples = PREFILTER_SAMPLES;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--bench-half") {
+            Benchmark::halfConversion(ENVMAP_RES);
+            exit(EXIT_SUCCESS);
+        }
+        else if (arg == "--cpu") {
+            options.useCPU = true;
+        }
+        else if (arg == "--area-filter") {
+            options.areaFilter = true;
+        }
+        else if (arg == "--light-sampling") {
+            options.lightSamples = LIGHT_SAMPLES;
+        }
+        else if (arg == "--force") {
+            options.useCache = false;
+        }
+        else if (arg == "--headless") {
+            headless = true;
+        }
+        else if (arg == "--per-face") {
+            options.layeredRendering = false;
+        }
+        else if (arg == "--compute") {
+            options.computeShaders = true;
+        }
+        else if (arg == "--float-readback") {
+            options.halfReadback = false;
+        }
+        else if (arg == "--bc6h" || arg == "--bc6h-fast" || arg == "--bc6h-slow") {
+            options.outputFormat = OutputFormat::BC6H;
+            options.bc6hQuality = arg == "--bc6h-fast" ? BC6HQuality::Fast : arg == "--bc6h-slow" ? BC6HQuality::Slow : BC6HQuality::Normal;
+        }
+        else if (arg == "--rgb9e5") {
+            options.outputFormat = OutputFormat::RGB9E5;
+        }
+        else if (arg == "--rgbm") {
+            options.outputFormat = OutputFormat::RGBM;
+        }
+        else if (arg == "--rgbd") {
+            options.outputFormat = OutputFormat::RGBD;
+        }
+        else if (arg == "--bc3") {
+            options.bc3 = true;
+        }
+        else if (arg == "--bundle") {
+            options.bundle = true;
+        }
+        else if (arg == "--array") {
+            options.cubemapArray = true;
+        }
+        else if (arg == "--sh") {
+            options.irradiance = IrradianceMode::SH;
+        }
+        else if (arg == "--sh-only") {
+            options.irradiance = IrradianceMode::SHOnly;
+        }
+        else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            std::cerr << "Usage: PBRBaker [--bench-half] [--cpu] [--area-filter] [--light-sampling] [--headless] [--force] [--per-face] [--compute] [--float-readback] [--bc6h | --bc6h-fast | --bc6h-slow | --rgb9e5 | --rgbm | --rgbd] [--bc3] [--bundle | --array] [--sh | --sh-only]" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
 
-	// Initialize OpenGL state
-	glEnable(GL_DEPTH_TEST);
-	glDepthFunc(GL_LEQUAL);
+    if (options.bc3 && !hasRanges(options)) {
+        std::cout << "[WARNING] --bc3 only applies to --rgbm and --rgbd, ignoring it" << std::endl;
+        options.bc3 = false;
+    }
+    if (options.bundle && options.cubemapArray) {
+        std::cout << "[WARNING] --bundle does not apply to --array, ignoring it" << std::endl;
+        options.bundle = false;
+    }
 
-	int fwidth, fheight;
-	glfwGetFramebufferSize(window, &fwidth, &fheight);
-	glViewport(0, 0, fwidth, fheight);
+    // The LUT does not depend on the images nor the backend, it is baked on the CPU in both cases
+    fs::path outputFolder = fs::current_path() / "output";
+    if (!fs::exists(outputFolder))
+        fs::create_directory(outputFolder);
+    gli::texture2d brdfLut = bakeBRDFLut(outputFolder, options.useCache);
 
     std::string path = std::string(fs::current_path().string()) + "/input";
+    std::vector<std::string> filepaths;
     for (const auto& entry : fs::directory_iterator(path)) {
-        generateMaps(entry.path().string());
+        filepaths.push_back(entry.path().string());
+    }
+    // The layers of --array follow the file names
+    std::sort(filepaths.begin(), filepaths.end());
+
+    // The CPU backend needs no window nor GL context
+    if (options.useCPU) {
+        CPUBaker baker(options);
+        bakeBatch(baker, filepaths, options, brdfLut);
+        exit(EXIT_SUCCESS);
+    }
+
+    GLContext context;
+    if (!context.create(headless)) {
+        std::cerr << "ERROR: " << context.error() << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+	// Initialize OpenGL state
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_LEQUAL);
+	// Filter across cube faces, the CPU baker does the same
+	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+    {
+        // The baker owns GL objects, destroy it while the context is still alive
+        Baker baker(options);
+        bakeBatch(baker, filepaths, options, brdfLut);
     }
 
-	glfwDestroyWindow(window);
-	glfwTerminate();
+    context.destroy();
 	exit(EXIT_SUCCESS);
 }
\ No newline at end of file
@@ -0,0 +1,21 @@
+#version 330 core
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 3) out;
+
+in vec3 vertexPos[];
+flat in int vertexFace[];
+
+out vec3 localPos;
+
+// Pass-through that routes every triangle to the cubemap face of its instance
+void main()
+{
+    for (int i = 0; i < 3; i++)
+    {
+        gl_Layer = vertexFace[0];
+        localPos = vertexPos[i];
+        gl_Position = gl_in[i].gl_Position;
+        EmitVertex();
+    }
+    EndPrimitive();
+}
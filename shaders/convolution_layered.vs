@@ -0,0 +1,16 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+out vec3 vertexPos;
+flat out int vertexFace;
+
+uniform mat4 projection;
+uniform mat4 views[6];
+
+// Drawn with 6 instances, instance i renders the cube into face i
+void main()
+{
+    vertexPos = aPos;
+    vertexFace = gl_InstanceID;
+    gl_Position =  projection * views[gl_InstanceID] * vec4(aPos, 1.0);
+}
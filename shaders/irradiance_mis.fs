@@ -0,0 +1,51 @@
+#version 330 core
+out vec4 FragColor;
+in vec3 localPos;
+
+// Light sampling version of irradiance.fs, see LightSampler. The cosine samples hold
+// tangent space L with NdotL in z and their pdf in w, the light samples world space L
+// and their solid angle pdf. lightMap is the environment at the resolution of the light
+// sampler with the pdf per unit of face area in a.
+uniform samplerBuffer cosineSamples;
+uniform int cosineSampleCount;
+uniform samplerBuffer lightSamples;
+uniform int lightSampleCount;
+uniform samplerCube lightMap;
+
+const float PI = 3.14159265359;
+
+// Radiance of the light map texel holding L in rgb, and the solid angle pdf of the light samples in a
+vec4 lightTexel(vec3 L)
+{
+    vec3 a = abs(L);
+    float r = length(L) / max(a.x, max(a.y, a.z));
+    vec4 t = textureLod(lightMap, L, 0.0);
+    return vec4(t.rgb, t.a * r * r * r);
+}
+
+void main()
+{
+    vec3 N = normalize(localPos);
+    vec3 up    = abs(N.z) < 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(1.0, 0.0, 0.0);
+    vec3 right = normalize(cross(up, N));
+    up = cross(N, right);
+
+    // Balance heuristic, mirrors CPUBaker::irradiance(): each sample adds L * NdotL / PI
+    // divided by the sum of count * pdf of both strategies
+    vec3 irradiance = vec3(0.0);
+    for (int i = 0; i < cosineSampleCount; ++i)
+    {
+        vec4 s = texelFetch(cosineSamples, i);
+        vec4 light = lightTexel(s.x * right + s.y * up + s.z * N);
+        irradiance += light.rgb * (s.z / PI / (float(cosineSampleCount) * s.w + float(lightSampleCount) * light.a));
+    }
+    for (int i = 0; i < lightSampleCount; ++i)
+    {
+        vec4 s = texelFetch(lightSamples, i);
+        float NdotL = dot(N, s.xyz);
+        if (NdotL > 0.0)
+            irradiance += lightTexel(s.xyz).rgb * (NdotL / PI / (float(cosineSampleCount) * NdotL / PI + float(lightSampleCount) * s.w));
+    }
+
+    FragColor = vec4(irradiance, 1.0);
+}
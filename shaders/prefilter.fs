@@ -3,95 +3,93 @@ out vec4 FragColor;
 in vec3 localPos;
 
 uniform samplerCube environmentMap;
+
+// GGX samples of the level being rendered, precomputed by the baker (see GGXSamples):
+// tangent space L with NdotL in z, and the environment mip level in w
+uniform samplerBuffer samples;
+uniform int sampleOffset;
+uniform int sampleCount;
+
+// Light sampling, see LightSampler: lightSampleCount is 0 without it. The light samples
+// hold world space L in xyz and their solid angle pdf in w, lightMap the environment at
+// the resolution of the light sampler with the pdf per unit of face area in a.
+uniform samplerBuffer lightSamples;
+uniform int lightSampleCount;
+uniform samplerCube lightMap;
+// Roughness of the level and GGX samples drawn for it, horizon included
 uniform float roughness;
+uniform float ggxSampleCount;
 
 const float PI = 3.14159265359;
 
-float RadicalInverse_VdC(uint bits) 
+// Radiance of the light map texel holding L in rgb, and the solid angle pdf of the light samples in a
+vec4 lightTexel(vec3 L)
 {
-    bits = (bits << 16u) | (bits >> 16u);
-    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
-    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
-    bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
-    bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
-    return float(bits) * 2.3283064365386963e-10; // / 0x100000000
+    vec3 a = abs(L);
+    float r = 1.0 / max(a.x, max(a.y, a.z));
+    vec4 t = textureLod(lightMap, L, 0.0);
+    return vec4(t.rgb, t.a * r * r * r);
 }
-// ----------------------------------------------------------------------------
-vec2 Hammersley(uint i, uint N)
+
+// Balance heuristic weight of a sample, GGX pdf of L with V = N is D / 4
+float misWeight(float NdotL, float lightPdf)
 {
-    return vec2(float(i)/float(N), RadicalInverse_VdC(i));
+    float a2 = roughness * roughness * roughness * roughness;
+    // NdotH^2 from the half angle between N and L
+    float denom = 0.5 * (1.0 + NdotL) * (a2 - 1.0) + 1.0;
+    float D = a2 / (PI * denom * denom);
+    return D * NdotL / (ggxSampleCount * 0.25 * D + float(lightSampleCount) * lightPdf);
 }
 
-vec3 ImportanceSampleGGX(vec2 Xi, vec3 N, float roughness)
-{
-    float a = roughness*roughness;
-	
-    float phi = 2.0 * PI * Xi.x;
-    float cosTheta = sqrt((1.0 - Xi.y) / (1.0 + (a*a - 1.0) * Xi.y));
-    float sinTheta = sqrt(1.0 - cosTheta*cosTheta);
-	
-    // from spherical coordinates to cartesian coordinates
-    vec3 H;
-    H.x = cos(phi) * sinTheta;
-    H.y = sin(phi) * sinTheta;
-    H.z = cosTheta;
-	
+void main()
+{		
+    vec3 N = normalize(localPos);
+
     // from tangent-space vector to world-space sample vector
     vec3 up        = abs(N.z) < 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(1.0, 0.0, 0.0);
     vec3 tangent   = normalize(cross(up, N));
     vec3 bitangent = cross(N, tangent);
-	
-    vec3 sampleVec = tangent * H.x + bitangent * H.y + N * H.z;
-    return normalize(sampleVec);
-}
-
-float DistributionGGX(float NdotH, float roughness) {
-    float a = roughness * roughness;
-    float a2 = a * a;
 
-    float NdotH2 = NdotH * NdotH;
-
-    float denom = (NdotH2 * (a2 - 1.0) + 1.0);
-    denom = PI * (denom * denom);
-    return a2 / denom;
-}
-  
-void main()
-{		
-    vec3 N = normalize(localPos);    
-    vec3 R = N;
-    vec3 V = R;
+    if (lightSampleCount > 0)
+    {
+        // Multiple importance sampling of the GGX and light samples, mirrors CPUBaker::prefilter()
+        float totalWeight = 0.0;
+        vec3 prefilteredColor = vec3(0.0);
+        for (int i = 0; i < sampleCount; ++i)
+        {
+            vec4 s = texelFetch(samples, sampleOffset + i);
+            vec3 L = normalize(tangent * s.x + bitangent * s.y + N * s.z);
+            vec4 light = lightTexel(L);
+            float weight = misWeight(s.z, light.a);
+            prefilteredColor += light.rgb * weight;
+            totalWeight += weight;
+        }
+        for (int i = 0; i < lightSampleCount; ++i)
+        {
+            vec4 s = texelFetch(lightSamples, i);
+            float NdotL = dot(N, s.xyz);
+            if (NdotL > 0.0)
+            {
+                float weight = misWeight(NdotL, s.w);
+                prefilteredColor += lightTexel(s.xyz).rgb * weight;
+                totalWeight += weight;
+            }
+        }
+        FragColor = vec4(prefilteredColor / totalWeight, 1.0);
+        return;
+    }
 
-    const uint SAMPLE_COUNT = 4096u;
-    //const uint SAMPLE_COUNT = 1024u;
     float totalWeight = 0.0;   
     vec3 prefilteredColor = vec3(0.0);     
-    for(uint i = 0u; i < SAMPLE_COUNT; ++i)
+    for(int i = 0; i < sampleCount; ++i)
     {
-        vec2 Xi = Hammersley(i, SAMPLE_COUNT);
-        vec3 H  = ImportanceSampleGGX(Xi, N, roughness);
-        vec3 L  = normalize(2.0 * dot(V, H) * H - V);
-
-        float NdotL = max(dot(N, L), 0.0);
-        if(NdotL > 0.0)
-        {
-            // sample from the environment's mip level based on roughness/pdf
-            float NdotH = max(dot(N, H), 0.0);
-            float HdotV = max(dot(H, V), 0.0);
-            float D   = DistributionGGX(NdotH, roughness);
-            float pdf = D * NdotH / (4.0 * HdotV) + 0.0001; 
+        vec4 s = texelFetch(samples, sampleOffset + i);
+        vec3 L = normalize(tangent * s.x + bitangent * s.y + N * s.z);
 
-            float resolution = 512.0; // resolution of source cubemap (per face)
-            float saTexel  = 4.0 * PI / (6.0 * resolution * resolution);
-            float saSample = 1.0 / (float(SAMPLE_COUNT) * pdf + 0.0001);
-
-            float mipLevel = roughness == 0.0 ? 0.0 : 0.5 * log2(saSample / saTexel); 
-            
-            prefilteredColor += textureLod(environmentMap, L, mipLevel).rgb * NdotL;
-            totalWeight += NdotL;
-        }
+        prefilteredColor += textureLod(environmentMap, L, s.w).rgb * s.z;
+        totalWeight += s.z;
     }
     prefilteredColor = prefilteredColor / totalWeight;
 
     FragColor = vec4(prefilteredColor, 1.0);
-}  
\ No newline at end of file
+}